@@ -0,0 +1,15 @@
+#include "blockcache.h"
+
+basic_block& block_cache::get(uint32_t pc)
+{
+    auto& block = m_blocks[pc];
+    if (!block)
+    {
+        block.reset(new basic_block());
+        block->start_pc = pc;
+        block->generation = 0;
+        block->successor_pc[0] = block->successor_pc[1] = 0;
+        block->successor[0] = block->successor[1] = nullptr;
+    }
+    return *block;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "common.h"
+#include "decodecache.h"
+
+//
+// Basic block cache
+// A block is a run of instructions recorded the first time they execute. It ends at a control flow instruction
+// (see "block_end" in opcodes.json), at the end of a decode cache page or after max_block_length instructions.
+// Blocks are validated against the generation of their decode cache page on entry, so writes to a block take
+// effect the next time it is entered. Each block remembers up to two successors, so the common exits (taken and
+// not taken branch, call and return) link directly to the next block without a map lookup.
+//
+
+struct block_op
+{
+    inst_func_ptr_t handler;
+    uint32_t pc;
+    uint16_t opcode;
+    uint16_t count;         // Instructions run by 'handler', 2 for a fused pair (the second op is then skipped)
+};
+
+struct basic_block
+{
+    uint32_t start_pc;
+    uint32_t generation;    // Generation of the decode cache page at record time (0 means the block must be recorded)
+    std::vector<block_op> ops;
+    uint32_t successor_pc[2];
+    basic_block* successor[2];
+
+    INLINE basic_block* find_successor(uint32_t pc)
+    {
+        if (successor_pc[0] == pc && successor[0] != nullptr)
+        {
+            return successor[0];
+        }
+        if (successor_pc[1] == pc && successor[1] != nullptr)
+        {
+            return successor[1];
+        }
+        return nullptr;
+    }
+
+    INLINE void link(uint32_t pc, basic_block* block)
+    {
+        // Note: The first slot keeps the first successor seen, the second one follows the most recent other exit
+        uint32_t slot = (successor[0] == nullptr) ? 0 : 1;
+        successor_pc[slot] = pc;
+        successor[slot] = block;
+    }
+
+    // Note: Recording ends at the first instruction that does not fall through, so the ops cover [start_pc, ops.back().pc]
+    INLINE bool contains(uint32_t pc)
+    {
+        return pc > start_pc && pc <= ops.back().pc;
+    }
+};
+
+class block_cache
+{
+public:
+    static const size_t max_block_length = 64;
+
+    // Returns the block starting at 'pc', creating an empty (not yet recorded) one if needed.
+    // Blocks are re-recorded in place, so pointers to them stay valid for the lifetime of the cache.
+    basic_block& get(uint32_t pc);
+
+private:
+    std::unordered_map<uint32_t, std::unique_ptr<basic_block>> m_blocks;
+};
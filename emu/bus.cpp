@@ -0,0 +1,69 @@
+#include "bus.h"
+
+memory_bus::page_table memory_bus::s_unmapped = {};
+
+memory_bus::memory_bus()
+    : m_memory(nullptr)
+    , m_address_space_size(0)
+    , m_low_table(s_unmapped)
+{
+    for (uint32_t i = 0; i < directory_size; i++)
+    {
+        m_directory[i] = &s_unmapped;
+    }
+    m_directory[0] = &m_low_table;
+}
+
+void memory_bus::attach_memory(uint8_t* memory, size_t address_space_size)
+{
+    IF_FALSE_THROW((address_space_size & page_mask) == 0 && address_space_size <= (size_t(1) << 32), "Invalid address space size: 0x" << std::hex << address_space_size);
+    m_memory = memory;
+    m_address_space_size = address_space_size;
+    m_tables.clear();
+    m_low_table = s_unmapped;
+    for (uint32_t i = 0; i < directory_size; i++)
+    {
+        m_directory[i] = &s_unmapped;
+    }
+    m_directory[0] = &m_low_table;
+}
+
+void memory_bus::map_ram(uint32_t address, size_t size)
+{
+    map(address, size, true, true, nullptr);
+}
+
+void memory_bus::map_rom(uint32_t address, size_t size)
+{
+    // Note: Writes to ROM are dropped
+    map(address, size, true, false, nullptr);
+}
+
+void memory_bus::map_device(uint32_t address, size_t size, bus_device* device)
+{
+    IF_FALSE_THROW(device != nullptr, "Invalid device");
+    map(address, size, false, false, device);
+}
+
+void memory_bus::map(uint32_t address, size_t size, bool readable, bool writable, bus_device* device)
+{
+    IF_FALSE_THROW((address & page_mask) == 0 && (size & page_mask) == 0, "Bus mappings must be page aligned: 0x" << std::hex << address << ", 0x" << size);
+    IF_FALSE_THROW(size_t(address) + size <= m_address_space_size, "Bus mapping exceeds the address space: 0x" << std::hex << address << ", 0x" << size);
+
+    for (size_t offset = 0; offset < size; offset += page_size)
+    {
+        size_t page_address = size_t(address) + offset;
+        size_t directory_index = page_address >> (page_bits + table_bits);
+        if (m_directory[directory_index] == &s_unmapped)
+        {
+            m_tables.emplace_back(new page_table(s_unmapped));
+            m_directory[directory_index] = m_tables.back().get();
+        }
+
+        page_entry& entry = m_directory[directory_index]->pages[(page_address >> page_bits) & (table_size - 1)];
+        uint8_t* host = m_memory + page_address;
+        entry.read = readable ? host : nullptr;
+        entry.write = writable ? host : nullptr;
+        entry.device = device;
+    }
+}
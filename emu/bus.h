@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "common.h"
+
+//
+// Memory bus
+// The guest address space is split in pages, each of which maps to host RAM, read-only host memory (ROM), a device or
+// nothing. RAM and ROM pages resolve to a host pointer through a page table lookup, so only device pages, unmapped pages
+// and accesses that straddle two pages leave the fast path. The page table of the first 16 MB (all of a 68000's address
+// space) is part of the bus and takes a single lookup. Wider address spaces go through a directory of page tables, one
+// per 16 MB, for the rest: those tables are allocated the first time a page in them is mapped, the rest of the directory
+// points at a shared table of unmapped pages, so a sparse 32-bit address space costs a few KB.
+//
+
+class bus_device
+{
+public:
+    virtual ~bus_device() {}
+
+    // 'size' is 1, 2 or 4 bytes, values are in the low bits
+    virtual uint32_t read(uint32_t address, uint32_t size) = 0;
+    virtual void write(uint32_t address, uint32_t size, uint32_t value) = 0;
+};
+
+class memory_bus
+{
+public:
+    static const uint32_t page_bits = 16;
+    static const uint32_t page_size = 1 << page_bits;
+    static const uint32_t page_mask = page_size - 1;
+    static const uint32_t table_bits = 24 - page_bits;     // A 68000 address space fits in a single page table
+    static const uint32_t table_size = 1 << table_bits;
+    static const uint32_t directory_size = 1 << (32 - page_bits - table_bits);
+
+    memory_bus();
+
+    // Sets the host memory backing RAM and ROM pages, guest addresses map 1:1 onto it. Every page starts out unmapped.
+    void attach_memory(uint8_t* memory, size_t address_space_size);
+
+    void map_ram(uint32_t address, size_t size);
+    void map_rom(uint32_t address, size_t size);
+    void map_device(uint32_t address, size_t size, bus_device* device);
+
+    // Host memory of the page holding 'address', or nullptr if the page can not be read (written) directly
+    INLINE uint8_t* get_read_page(uint32_t address)
+    {
+        return get_entry(address).read;
+    }
+
+    INLINE uint8_t* get_write_page(uint32_t address)
+    {
+        return get_entry(address).write;
+    }
+
+    INLINE bus_device* get_device(uint32_t address)
+    {
+        return get_entry(address).device;
+    }
+
+private:
+    struct page_entry
+    {
+        uint8_t* read;
+        uint8_t* write;
+        bus_device* device;
+    };
+
+    struct page_table
+    {
+        page_entry pages[table_size];
+    };
+
+    static page_table s_unmapped;    // Shared by every directory entry without a page table of its own, never written
+
+    uint8_t* m_memory;
+    size_t m_address_space_size;
+    page_table m_low_table;                 // Pages of the first 16 MB, m_directory[0] points at it
+    page_table* m_directory[directory_size];
+    std::vector<std::unique_ptr<page_table>> m_tables;
+
+    INLINE page_entry& get_entry(uint32_t address)
+    {
+        // Note: Tests the address rather than a mode flag, so 24-bit addresses never touch the directory
+        if ((address >> (page_bits + table_bits)) == 0)
+        {
+            return m_low_table.pages[address >> page_bits];
+        }
+        return m_directory[address >> (page_bits + table_bits)]->pages[(address >> page_bits) & (table_size - 1)];
+    }
+
+    void map(uint32_t address, size_t size, bool readable, bool writable, bus_device* device);
+};
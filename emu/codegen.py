@@ -56,33 +56,255 @@ def getTemplateParams(opcode, bitPattern):
             result.append(param)
     return result
 
+def getModeMask(opcode, bitPattern):
+    # Mask and value of the addressing mode bits in all (non template) effective address fields of 'bitPattern'.
+    # Mode 7 uses the register field to select the sub mode, so both fields are fixed in that case.
+    mask = 0
+    bitIndex = 0
+    for piece in opcode['pattern']:
+        bits = piece['bits']
+        bitIndex += bits
+        if 'modes' in piece and not piece.get('template', False):
+            value = (bitPattern >> (16 - bitIndex)) & 0x3f
+            swapped = piece.get('swapped', False)
+            mode = (value & 0x7) if swapped else (value >> 3)
+            if mode == 7:
+                fieldMask = 0x3f
+            else:
+                fieldMask = 0x7 if swapped else 0x38
+            mask |= fieldMask << (16 - bitIndex)
+    return mask, bitPattern & mask
+
+def makeSpecializedFunctionName(func, mask, bits):
+    if mask == 0:
+        return func
+    return 'specialized<{}, {:#06x}, {:#06x}>'.format(func, mask, bits)
+
+def makeFunctionName(opcode, templateParams):
+    if len(templateParams) == 0:
+        return opcode['name']
+    func = '{}<{}' + ', {}' * (len(templateParams) - 1) + '>'
+    return func.format(opcode['name'], *templateParams)
+
+def writeTables(f, entries, userEntries, functions, mnemonicIndices, mnemonics, blockEnds):
+    # Handler per opcode, per mode
+    for name, table in [('opcode_table', entries), ('user_opcode_table', userEntries)]:
+        f.write('constexpr inst_func_ptr_t {}[0x10000] = {{\n'.format(name))
+        for bitPattern in range(0, 0x10000):
+            f.write('    {},\n'.format(table[bitPattern]))
+        f.write('};\n')
+    # Trace mode runs every opcode through the same wrapper
+    f.write('constexpr inst_func_ptr_t trace_opcode_table[0x10000] = {\n')
+    for row in range(0, 0x10000, 16):
+        f.write('    {},\n'.format(', '.join(['trace'] * 16)))
+    f.write('};\n')
+    # Compact form: dense array of the unique handlers and a 16-bit index into it per opcode, per mode
+    handlerIndices = {}
+    f.write('constexpr inst_func_ptr_t handlers[{}] = {{\n'.format(len(functions)))
+    for index, func in enumerate(functions):
+        handlerIndices[func] = index
+        f.write('    {},\n'.format(func))
+    f.write('};\n')
+    for name, table in [('handler_index_table', entries), ('user_handler_index_table', userEntries)]:
+        f.write('constexpr uint16_t {}[0x10000] = {{\n'.format(name))
+        for row in range(0, 0x10000, 16):
+            f.write('    {},\n'.format(', '.join(str(handlerIndices[table[bitPattern]]) for bitPattern in range(row, row + 16))))
+        f.write('};\n')
+    # Index into 'mnemonics' per opcode, unassigned opcodes use index 0
+    f.write('constexpr uint16_t mnemonic_index_table[0x10000] = {\n')
+    for row in range(0, 0x10000, 16):
+        f.write('    {},\n'.format(', '.join(str(mnemonicIndices.get(bitPattern, 0)) for bitPattern in range(row, row + 16))))
+    f.write('};\n')
+    f.write('constexpr const char* mnemonics[{}] = {{\n'.format(len(mnemonics)))
+    for mnemonic in mnemonics:
+        f.write('    "{}",\n'.format(mnemonic))
+    f.write('};\n')
+    # Opcodes that end a basic block
+    f.write('constexpr bool block_end_table[0x10000] = {\n')
+    for row in range(0, 0x10000, 16):
+        f.write('    {},\n'.format(', '.join('true' if bitPattern in blockEnds else 'false' for bitPattern in range(row, row + 16))))
+    f.write('};\n')
+
+def writeFusion(f, fusionFirst, fusionSecond, fusedHandlers, firstCount, secondCount):
+    # Fusion class per opcode as the first and as the second instruction of a pair (0 means never fused)
+    for name, classes in [('fusion_first_table', fusionFirst), ('fusion_second_table', fusionSecond)]:
+        f.write('constexpr uint8_t {}[0x10000] = {{\n'.format(name))
+        for row in range(0, 0x10000, 16):
+            f.write('    {},\n'.format(', '.join(str(classes.get(bitPattern, 0)) for bitPattern in range(row, row + 16))))
+        f.write('};\n')
+    # Fused handler per (first class - 1, second class - 1), row major, nullptr for pairs that are not fused
+    f.write('constexpr uint32_t fusion_second_count = {};\n'.format(secondCount))
+    f.write('constexpr inst_func_ptr_t fused_handlers[{}] = {{\n'.format(max(firstCount * secondCount, 1)))
+    for first in range(1, firstCount + 1):
+        for second in range(1, secondCount + 1):
+            f.write('    {},\n'.format(fusedHandlers.get((first, second), 'nullptr')))
+    if firstCount * secondCount == 0:
+        f.write('    nullptr,\n')
+    f.write('};\n')
+
+def matchesModes(opcode, bitPattern, modes):
+    # True if every named effective address field of 'bitPattern' uses one of the listed addressing modes
+    bitIndex = 0
+    for piece in opcode['pattern']:
+        bits = piece['bits']
+        bitIndex += bits
+        if piece.get('name') in modes:
+            value = (bitPattern >> (16 - bitIndex)) & 0x3f
+            mode = (value & 0x7) if piece.get('swapped', False) else (value >> 3)
+            if mode == 7:
+                mode = 7 + (((value >> 3) if piece.get('swapped', False) else value) & 0x7)
+            if not mode in modes[piece['name']]:
+                return False
+    return True
+
+def makeFusion(opcodes, fusion, entries, privileged):
+    # Each pattern fuses its first opcode with a directly following second opcode. Opcodes are grouped in classes by their
+    # handler and by the patterns they take part in, so the pair table only needs an entry per pair of classes.
+    def classify(role):
+        keys = {}
+        for opcode in opcodes:
+            for bitPattern in makeBitPatterns(opcode, 0, 0, 0):
+                if bitPattern in privileged:
+                    continue
+                patterns = tuple(index for index, pattern in enumerate(fusion)
+                    if pattern[role] == opcode['name'] and matchesModes(opcode, bitPattern, pattern.get(role + '_modes', {})))
+                if len(patterns) > 0:
+                    keys[bitPattern] = (entries[bitPattern], patterns)
+        classes = {}
+        result = {}
+        for bitPattern, key in keys.items():
+            if not key in classes:
+                classes[key] = len(classes) + 1
+            result[bitPattern] = classes[key]
+        if len(classes) > 255:
+            raise Exception('Too many fusion classes for {} opcodes'.format(role))
+        return result, classes
+
+    fusionFirst, firstClasses = classify('first')
+    fusionSecond, secondClasses = classify('second')
+    fusedHandlers = {}
+    for (firstFunc, firstPatterns), first in firstClasses.items():
+        for (secondFunc, secondPatterns), second in secondClasses.items():
+            if len(set(firstPatterns) & set(secondPatterns)) > 0:
+                fusedHandlers[(first, second)] = 'fused<{}, {}>'.format(firstFunc, secondFunc)
+    return fusionFirst, fusionSecond, fusedHandlers, len(firstClasses), len(secondClasses)
+
+def readProfile(path, hotCount):
+    # Lines of "opcode count" as written by 'emu --profile', returns the 'hotCount' most executed opcodes
+    counts = {}
+    with open(path, 'r') as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 2:
+                counts[int(fields[0], 0)] = counts.get(int(fields[0], 0), 0) + int(fields[1])
+    return set(sorted(counts, key=lambda opcode: counts[opcode], reverse=True)[:hotCount])
+
+def getArgument(name, default):
+    args = sys.argv[1:]
+    return args[args.index(name) + 1] if name in args[:-1] else default
+
+def writeThreaded(f, entries, userEntries, functions):
+    # Label table per mode, one entry per opcode
+    labels = {}
+    for index, func in enumerate(functions):
+        labels[func] = 'handler_{}'.format(index)
+    for name, table in [('supervisor_labels', entries), ('user_labels', userEntries)]:
+        f.write('static const void* const {}[0x10000] = {{\n'.format(name))
+        for bitPattern in range(0, 0x10000):
+            f.write('    &&{},\n'.format(labels[table[bitPattern]]))
+        f.write('};\n')
+    f.write('const void* const* labels = state.get_status_bit<bit::supervisor>() ? supervisor_labels : user_labels;\n')
+    f.write('DISPATCH();\n')
+    # Handler bodies, each one ending in its own dispatch
+    for func in functions:
+        f.write('{}: {}(state, opcode); NEXT_INSTRUCTION();\n'.format(labels[func], func))
+
 try:
 
+    # Note: Pass --specialize-ea to generate a handler per addressing mode combination (larger, but faster, binary)
+    specializeEA = '--specialize-ea' in sys.argv[1:]
+
+    # Note: Pass --profile <file> (written by 'emu --profile <file>') to give the hottest opcodes (--hot, default 256) a
+    # handler of their own, with every opcode bit (addressing modes and registers) folded in. The long tail keeps the
+    # shared handlers, so the binary only grows by the handlers that run.
+    profilePath = getArgument('--profile', None)
+    hot = readProfile(profilePath, int(getArgument('--hot', '256'))) if profilePath is not None else set()
+
     with open('opcodes.json', 'r') as f:
         opcodes = json.load(f)
 
-    with open('generated.cpp', 'w') as f:
-        occupied = {}
-        unique = set()
-        for opcode in opcodes:
-            bitPatterns = makeBitPatterns(opcode, 0, 0, 0)
-            for bitPattern in bitPatterns:
-                if bitPattern in occupied:
-                    conflict = occupied[bitPattern]
-                    raise Exception('Bit pattern ({:016b}) for [{}] is already in use by [{}]'.format(bitPattern, opcode['name'], conflict['name']))
-                occupied[bitPattern] = opcode
-                templateParams = getTemplateParams(opcode, bitPattern)
-                if len(templateParams) == 0:
-                    func = opcode['name']
-                    code = 'table[{:#06x}] = {};\n'.format(bitPattern, func)
-                else:
-                    func = '{}<{}' + ', {}' * (len(templateParams) - 1) + '>'
-                    func = func.format(opcode['name'], *templateParams)
-                    code = 'table[{:#06x}] = {};\n'
-                    code = code.format(bitPattern, func)
+    # Note: Only non-branching first opcodes that never raise an exception or write memory are listed in fusion.json, so the
+    # second opcode always directly follows the first one and cannot have been modified by it
+    with open('fusion.json', 'r') as f:
+        fusion = json.load(f)
+
+    occupied = {}
+    entries = {}
+    mnemonics = ['(unassigned)']
+    mnemonicIndices = {}
+    functions = []
+    unique = set()
+    blockEnds = set()
+    privileged = set()
+    fusionEntries = {}
+    for opcode in opcodes:
+        mnemonics.append(opcode['name'].lstrip('_'))
+        bitPatterns = makeBitPatterns(opcode, 0, 0, 0)
+        for bitPattern in bitPatterns:
+            if bitPattern in occupied:
+                conflict = occupied[bitPattern]
+                raise Exception('Bit pattern ({:016b}) for [{}] is already in use by [{}]'.format(bitPattern, opcode['name'], conflict['name']))
+            occupied[bitPattern] = opcode
+            func = makeFunctionName(opcode, getTemplateParams(opcode, bitPattern))
+            if specializeEA:
+                mask, bits = getModeMask(opcode, bitPattern)
+                func = makeSpecializedFunctionName(func, mask, bits)
+            # Note: Fused pairs are built from the shared handlers, one per hot opcode would multiply the pair table
+            fusionEntries[bitPattern] = func
+            if bitPattern in hot:
+                func = makeSpecializedFunctionName(makeFunctionName(opcode, getTemplateParams(opcode, bitPattern)), 0xffff, bitPattern)
+            if not func in unique:
                 unique.add(func)
-                f.write(code);
-        print('Unique template function instantiations: {}'.format(len(unique)))
+                functions.append(func)
+            entries[bitPattern] = func
+            mnemonicIndices[bitPattern] = len(mnemonics) - 1
+            if opcode.get('block_end', False):
+                blockEnds.add(bitPattern)
+            if opcode.get('privileged', False):
+                privileged.add(bitPattern)
+
+    # Unassigned opcodes raise an illegal instruction exception (line A and F opcodes have their own vectors), so every
+    # slot of the tables holds a handler
+    for bitPattern in range(0, 0x10000):
+        if not bitPattern in entries:
+            func = {0xa: 'line_a', 0xf: 'line_f'}.get(bitPattern >> 12, 'illegal')
+            if not func in unique:
+                unique.add(func)
+                functions.append(func)
+            entries[bitPattern] = func
+            blockEnds.add(bitPattern)
+
+    # User mode gets its own table, where privileged opcodes raise a privilege violation exception. The handlers of
+    # privileged opcodes can then assume supervisor mode instead of testing for it.
+    userEntries = dict(entries)
+    if len(privileged) > 0:
+        functions.append('privilege_violation')
+        for bitPattern in privileged:
+            userEntries[bitPattern] = 'privilege_violation'
+
+    fusionFirst, fusionSecond, fusedHandlers, firstCount, secondCount = makeFusion(opcodes, fusion, fusionEntries, privileged)
+
+    with open('generated.cpp', 'w') as f:
+        writeTables(f, entries, userEntries, functions, mnemonicIndices, mnemonics, blockEnds)
+        writeFusion(f, fusionFirst, fusionSecond, fusedHandlers, firstCount, secondCount)
+
+    with open('generated_threaded.cpp', 'w') as f:
+        writeThreaded(f, entries, userEntries, functions)
+
+    print('Unique template function instantiations: {}'.format(len(functions)))
+    print('Fused handlers: {}'.format(len(fusedHandlers)))
+    if profilePath is not None:
+        print('Profile specialized handlers: {}'.format(len(hot & set(occupied))))
 
 except Exception as ex:
     print('error: {}'.format(ex))
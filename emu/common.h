@@ -10,6 +10,27 @@
 
 #define INLINE __forceinline
 
+#if defined(__GNUC__) || defined(__clang__)
+#define HAS_COMPUTED_GOTO 1 // Labels as values (&&label, goto *ptr) are available
+#define FLATTEN __attribute__((flatten))
+#else
+#define HAS_COMPUTED_GOTO 0
+#define FLATTEN [[msvc::flatten]]
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAS_SSE2 1 // x86 host with SSE2 (always the case on x64)
+#else
+#define HAS_SSE2 0
+#endif
+
+// Guest memory layout. 0 keeps the big-endian image verbatim, so every access byte swaps. 1 stores every 16-bit word in
+// host order: bytes are addressed with (address ^ 1), words are plain loads and longs a load and a 16-bit rotate.
+// Note: Both layouts assume a little-endian host
+#ifndef NATIVE_ENDIAN_MEMORY
+#define NATIVE_ENDIAN_MEMORY 0
+#endif
+
 template <typename T>
 struct traits {};
 
@@ -86,24 +107,60 @@ INLINE bool most_significant_bit(T value)
     return (unsigned_t(value) >> ((sizeof(T) * 8) - 1)) != 0;
 }
 
+// MSVC only has the carry chain intrinsics on x86 and x64, other hosts (ARM64) use a wider sum
+#if !defined(__GNUC__) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#define HAS_CARRY_INTRINSICS 1
+#else
+#define HAS_CARRY_INTRINSICS 0
+#endif
+
+#if HAS_CARRY_INTRINSICS
+// Carry chain intrinsics (ADC/SBB) per operand size, see add_with_carry() and sub_with_borrow()
+INLINE uint8_t add_carry(uint8_t carry_in, uint8_t a, uint8_t b, uint8_t* result) { return _addcarry_u8(carry_in, a, b, result); }
+INLINE uint8_t add_carry(uint8_t carry_in, uint16_t a, uint16_t b, uint16_t* result) { return _addcarry_u16(carry_in, a, b, result); }
+INLINE uint8_t add_carry(uint8_t carry_in, uint32_t a, uint32_t b, uint32_t* result) { return _addcarry_u32(carry_in, a, b, result); }
+INLINE uint8_t sub_borrow(uint8_t borrow_in, uint8_t a, uint8_t b, uint8_t* result) { return _subborrow_u8(borrow_in, a, b, result); }
+INLINE uint8_t sub_borrow(uint8_t borrow_in, uint16_t a, uint16_t b, uint16_t* result) { return _subborrow_u16(borrow_in, a, b, result); }
+INLINE uint8_t sub_borrow(uint8_t borrow_in, uint32_t a, uint32_t b, uint32_t* result) { return _subborrow_u32(borrow_in, a, b, result); }
+#endif
+
+// a + b + carry_in, with the carry out and the signed overflow of the whole sum
+// Note: V is taken from the final result, the signed overflow of the two partial sums can cancel out
 template <typename T>
-INLINE bool has_carry(T higher_precision_result)
-{
-    return ((higher_precision_result >> (sizeof(T) * 4)) & 0x1) != 0;
+INLINE T add_with_carry(T a, T b, bool carry_in, bool& carry, bool& overflow)
+{
+    T result;
+#if defined(__GNUC__) || defined(__clang__)
+    T partial;
+    carry = __builtin_add_overflow(a, b, &partial) | __builtin_add_overflow(partial, T(carry_in), &result); // Note: At most one step carries
+#elif HAS_CARRY_INTRINSICS
+    carry = add_carry(uint8_t(carry_in), a, b, &result) != 0;
+#else
+    uint64_t sum = uint64_t(a) + uint64_t(b) + uint64_t(carry_in);
+    result = T(sum);
+    carry = ((sum >> (sizeof(T) * 8)) & 0x1) != 0;
+#endif
+    overflow = most_significant_bit(T((a ^ result) & (b ^ result)));
+    return result;
 }
 
+// a - b - borrow_in, with the borrow out and the signed overflow of the whole difference
 template <typename T>
-INLINE bool has_borrow(T a, T b)
-{
-    return a < b;
-}
-
-template <typename T>
-INLINE bool has_overflow(T op0, T op1, T result)
-{
-    bool op0_negative = is_negative(op0);
-    bool op1_negative = is_negative(op1);
-    return (op0_negative == op1_negative) ? op0_negative != is_negative(result) : false;
+INLINE T sub_with_borrow(T a, T b, bool borrow_in, bool& borrow, bool& overflow)
+{
+    T result;
+#if defined(__GNUC__) || defined(__clang__)
+    T partial;
+    borrow = __builtin_sub_overflow(a, b, &partial) | __builtin_sub_overflow(partial, T(borrow_in), &result); // Note: At most one step borrows
+#elif HAS_CARRY_INTRINSICS
+    borrow = sub_borrow(uint8_t(borrow_in), a, b, &result) != 0;
+#else
+    uint64_t difference = uint64_t(a) - uint64_t(b) - uint64_t(borrow_in); // Note: Wraps around, so a borrow sets every bit above T
+    result = T(difference);
+    borrow = ((difference >> (sizeof(T) * 8)) & 0x1) != 0;
+#endif
+    overflow = most_significant_bit(T((a ^ b) & (a ^ result)));
+    return result;
 }
 
 template <typename T>
@@ -0,0 +1,32 @@
+#include "decodecache.h"
+
+void decode_cache::invalidate_all()
+{
+    for (auto& owner : m_chunks)
+    {
+        if (owner)
+        {
+            for (uint32_t i = 0; i < pages_per_chunk; i++)
+            {
+                bump_generation(*owner, i);
+            }
+        }
+    }
+}
+
+void decode_cache::allocate_chunk(std::unique_ptr<chunk>& result)
+{
+    result.reset(new chunk());
+    std::fill(result->generations, result->generations + pages_per_chunk, 1); // Note: Generations start at 1 so zero initialized records are never current
+}
+
+void decode_cache::reset_page(chunk& owner, uint32_t page_index)
+{
+    // Note: The generation wrapped around, so old records could look current again. Clear the page instead.
+    if (owner.pages[page_index])
+    {
+        auto& records = owner.pages[page_index]->records;
+        std::fill(records, records + records_per_page, decoded_instruction());
+    }
+    owner.generations[page_index] = 1;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include "common.h"
+
+class machine_state;
+typedef void(*inst_func_ptr_t)(machine_state&, uint16_t);
+
+//
+// Pre-decoded instruction cache
+// Holds one record per (word aligned) guest PC, grouped in pages that are allocated the first time code in them executes.
+// A memory write that lands on a word marked as code (see mark_code()) bumps the generation of its page, which invalidates
+// all records decoded from that page. Writes to data, even next to code in the same page, leave the records alone.
+// Pages are grouped in chunks of 16 MB of address space (all of a 68000's), allocated the first time code in them runs,
+// so a sparse 32-bit address space only pays for the chunks it executes from.
+//
+
+struct decoded_instruction
+{
+    inst_func_ptr_t handler;
+    uint32_t generation;    // Generation of the owning page at decode time (0 means never decoded)
+    uint16_t opcode;
+    uint16_t count;         // Instructions run by 'handler', 2 for a fused pair (see get_fused_handler())
+    uint32_t operand;       // Extension words of the instruction, for handlers of get_decoded_operand_handler()
+};
+
+class decode_cache
+{
+public:
+    static const uint32_t page_bits = 12;
+    static const uint32_t page_size = 1 << page_bits;
+    static const uint32_t page_mask = page_size - 1;
+    static const uint32_t records_per_page = page_size / sizeof(uint16_t);
+    static const uint32_t chunk_bits = 24;
+    static const uint32_t pages_per_chunk = 1 << (chunk_bits - page_bits);
+    static const uint32_t chunk_count = 1 << (32 - chunk_bits);
+    static const uint32_t max_instruction_size = 10;    // Opcode and up to four extension words
+
+    void invalidate_all();
+
+    INLINE void invalidate(uint32_t address, uint32_t size)
+    {
+        auto last = address + size - 1;
+        if ((last >> page_bits) != (address >> page_bits))
+        {
+            invalidate_words(address, address | page_mask);
+            invalidate_words(last & ~page_mask, last);
+        }
+        else
+        {
+            invalidate_words(address, last);
+        }
+    }
+
+    // Returns the records of the page holding 'pc', the record for a (word aligned) pc is at index (pc & page_mask) >> 1.
+    // A record is current if its generation matches the page generation. Pages are never freed, so both pointers
+    // can be kept for as long as execution stays in the page.
+    INLINE decoded_instruction* get_page(uint32_t pc)
+    {
+        return get_code_page(pc).records;
+    }
+
+    // Marks the words an instruction decoded at 'pc' can span, writes to them invalidate the page.
+    // Note: Callers pass max_instruction_size when the length is not known, which may also cover data right after the last instruction
+    INLINE void mark_code(uint32_t pc, uint32_t size)
+    {
+        auto& page = get_code_page(pc);
+        auto first = (pc & page_mask) >> 1;
+        auto last = std::min((pc & page_mask) + size - 1, page_mask) >> 1;
+        for (uint32_t word = first; word <= last; word++)
+        {
+            page.code[word >> 6] |= uint64_t(1) << (word & 63);
+        }
+    }
+
+    INLINE const uint32_t* get_generation(uint32_t pc)
+    {
+        return &get_chunk(pc).generations[(pc >> page_bits) & (pages_per_chunk - 1)];
+    }
+
+private:
+    struct code_page
+    {
+        decoded_instruction records[records_per_page];
+        uint64_t code[records_per_page / 64];   // One bit per word, set by mark_code()
+    };
+
+    struct chunk
+    {
+        std::unique_ptr<code_page> pages[pages_per_chunk];
+        uint32_t generations[pages_per_chunk];
+    };
+
+    std::unique_ptr<chunk> m_chunks[chunk_count];
+
+    INLINE chunk& get_chunk(uint32_t pc)
+    {
+        auto& result = m_chunks[pc >> chunk_bits];
+        if (!result)
+        {
+            allocate_chunk(result);
+        }
+        return *result;
+    }
+
+    INLINE code_page& get_code_page(uint32_t pc)
+    {
+        auto& page = get_chunk(pc).pages[(pc >> page_bits) & (pages_per_chunk - 1)];
+        if (!page)
+        {
+            page.reset(new code_page());
+        }
+        return *page;
+    }
+
+    void allocate_chunk(std::unique_ptr<chunk>& result);
+    void reset_page(chunk& owner, uint32_t page_index);
+
+    INLINE void bump_generation(chunk& owner, uint32_t page_index)
+    {
+        if (++owner.generations[page_index] == 0)
+        {
+            reset_page(owner, page_index);
+        }
+    }
+
+    // Bumps the generation of the page holding 'first' if any word of [first, last] (both in that page) is marked as code
+    INLINE void invalidate_words(uint32_t first, uint32_t last)
+    {
+        // Note: Nothing was decoded from a chunk or page that was never allocated, so there is nothing to invalidate
+        auto& owner = m_chunks[first >> chunk_bits];
+        if (!owner)
+        {
+            return;
+        }
+
+        auto page_index = (first >> page_bits) & (pages_per_chunk - 1);
+        auto& page = owner->pages[page_index];
+        if (!page)
+        {
+            return;
+        }
+
+        for (uint32_t word = (first & page_mask) >> 1; word <= (last & page_mask) >> 1; word++)
+        {
+            if (page->code[word >> 6] & (uint64_t(1) << (word & 63)))
+            {
+                bump_generation(*owner, page_index);
+                return;
+            }
+        }
+    }
+};
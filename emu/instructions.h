@@ -13,17 +13,14 @@ void move(machine_state& state, uint16_t opcode)
     auto src = extract_bits<10, 6>(opcode);
     auto dst = extract_bits<4, 6>(opcode);
     
-    dst = (dst >> 3) | ((dst & 0x3) << 3); // Note: Swap upper and lower 3 bits
+    dst = (dst >> 3) | ((dst & 0x7) << 3); // Note: Swap upper and lower 3 bits
 
-    T* src_ptr = state.get_pointer<T>(src);
-    T* dst_ptr = state.get_pointer<T>(dst);
+    auto src_ptr = state.get_operand<T>(src);
+    auto dst_ptr = state.get_operand<T>(dst);
 
     T result = state.read(src_ptr);
 
-    state.set_status_bit<bit::negative>(is_negative(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
     state.write(dst_ptr, result);
 }
@@ -36,10 +33,8 @@ void move(machine_state& state, uint16_t opcode)
 void move_from_sr(machine_state& state, uint16_t opcode)
 {
     auto dst = extract_bits<10, 6>(opcode);
-    auto src_ptr = state.get_pointer<uint16_t>(reg::status_register);
-    auto dst_ptr = state.get_pointer<uint16_t>(dst);
-    auto result = state.read(src_ptr);
-    state.write(dst_ptr, result);
+    auto dst_ptr = state.get_operand<uint16_t>(dst);
+    state.write(dst_ptr, state.get_status_register());
 }
 
 //
@@ -50,10 +45,9 @@ void move_from_sr(machine_state& state, uint16_t opcode)
 void move_to_ccr(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    auto src_ptr = state.get_pointer<uint8_t>(ea);
-    auto dst_ptr = state.get_pointer<uint8_t>(reg::status_register);
+    auto src_ptr = state.get_operand<uint8_t>(ea);
     auto result = state.read(src_ptr);
-    state.write(dst_ptr, result);
+    state.set_condition_code_register(result);
 }
 
 //
@@ -64,11 +58,9 @@ void move_to_ccr(machine_state& state, uint16_t opcode)
 template <uint16_t src>
 void move_to_sr(machine_state& state, uint16_t opcode)
 {
-    CHECK_SUPERVISOR(state);
-    auto src_ptr = state.get_pointer<uint16_t>(src);
-    auto dst_ptr = state.get_pointer<uint16_t>(reg::status_register);
+    auto src_ptr = state.get_operand<uint16_t>(src);
     auto result = state.read(src_ptr);
-    state.write(dst_ptr, result);
+    state.set_status_register(result);
 }
 
 //
@@ -79,22 +71,21 @@ void move_to_sr(machine_state& state, uint16_t opcode)
 template <uint16_t dir>
 void move_usp(machine_state& state, uint16_t opcode)
 {
-    CHECK_SUPERVISOR(state);
-    auto ea = extract_bits<13, 3>(opcode);
-    auto reg_ptr = state.get_pointer<uint32_t>(reg::user_stack_pointer);
-    auto mem_ptr = state.get_pointer<uint32_t>(ea);
+    auto reg = extract_bits<13, 3>(opcode);
+    auto usp_ptr = state.get_pointer<uint32_t>(reg::user_stack_pointer);
+    auto reg_ptr = state.get_operand<uint32_t>(make_effective_address(1, reg));
     switch (dir)
     {
-    case 0: // Register to memory
+    case 0: // Address register to USP
     {
         auto result = state.read(reg_ptr);
-        state.write(mem_ptr, result);
+        state.write(usp_ptr, result);
     }
     break;
 
-    case 1: // Memory to register
+    case 1: // USP to address register
     {
-        auto result = state.read(mem_ptr);
+        auto result = state.read(usp_ptr);
         state.write(reg_ptr, result);
     }
     break;
@@ -114,13 +105,10 @@ void moveq(machine_state& state, uint16_t opcode)
     auto dst = extract_bits<4, 3>(opcode);
     auto data = extract_bits<8, 8>(opcode);
 
-    auto dst_ptr = state.get_pointer<uint32_t>(make_effective_address(0, dst));
+    auto dst_ptr = state.get_operand<uint32_t>(make_effective_address(0, dst));
     auto result = sign_extend(data);
 
-    state.set_status_bit<bit::negative>(is_negative(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
     state.write(dst_ptr, result);
 }
@@ -136,8 +124,8 @@ void movea(machine_state& state, uint16_t opcode)
     auto src_ea = extract_bits<10, 6>(opcode);
     auto dst_reg = extract_bits<4, 3>(opcode);
 
-    auto src_ptr = state.get_pointer<T>(src_ea);
-    auto dst_ptr = state.get_pointer<uint32_t>(make_effective_address(1, dst_reg));
+    auto src_ptr = state.get_operand<T>(src_ea);
+    auto dst_ptr = state.get_operand<uint32_t>(make_effective_address(1, dst_reg));
     auto val = state.read<T>(src_ptr);
     state.write<uint32_t>(dst_ptr, sign_extend(val));
 }
@@ -174,8 +162,8 @@ void movem(machine_state& state, uint16_t opcode)
             uint32_t reg_mode = (i >> 3) & 0x1;
             uint32_t reg_reg = i & 0x7;
 
-            T* reg = state.get_pointer<T>(make_effective_address(reg_mode, reg_reg));
-            T* mem = state.get_pointer<T>(src_ea);
+            auto reg = state.get_operand<T>(make_effective_address(reg_mode, reg_reg));
+            auto mem = state.get_operand<T>(src_ea);
 
             switch (dir)
             {
@@ -183,7 +171,7 @@ void movem(machine_state& state, uint16_t opcode)
                 state.write(mem, state.read(reg));
                 break;
             case 1: // Memory to register
-                state.write((uint32_t*)reg, sign_extend(state.read(mem)));
+                state.write(operand_cast<uint32_t>(reg), sign_extend(state.read(mem)));
                 break;
             default:
                 THROW("Invalid direction");
@@ -203,20 +191,27 @@ void movep(machine_state& state, uint16_t opcode)
     auto src_reg = extract_bits<4, 3>(opcode);
     auto dst_reg = extract_bits<13, 3>(opcode);
 
-    auto reg_ptr = state.get_pointer<uint8_t>(make_effective_address(0, src_reg)) + sizeof(T) - 1; // Note: Endian
-    auto mem_ptr = state.get_pointer<uint8_t>(make_effective_address(2, dst_reg)) + state.next<int16_t>();
+    auto reg_ptr = state.get_operand<uint32_t>(make_effective_address(0, src_reg));
+    auto address = state.get_address(state.get_operand<uint8_t>(make_effective_address(2, dst_reg))) + sign_extend(state.next<uint16_t>());
+    auto value = state.read(reg_ptr);
 
+    // Note: Bytes go to every other address, most significant byte first
     for (uint32_t i = 0; i < sizeof(T); i++)
     {
+        uint32_t shift = uint32_t(sizeof(T) - 1 - i) * 8;
+        uint32_t byte_address = state.mask_address(address + i * 2);
         switch (dir)
         {
-        case 0: state.write<uint8_t>(reg_ptr, state.read<uint8_t>(mem_ptr)); break; // Memory to register
-        case 1: state.write<uint8_t>(mem_ptr, state.read<uint8_t>(reg_ptr)); break; // Register to memory
+        case 0: value = (value & ~(0xffu << shift)) | (uint32_t(state.read_memory<uint8_t>(byte_address)) << shift); break; // Memory to register
+        case 1: state.write_memory<uint8_t>(byte_address, uint8_t(value >> shift)); break; // Register to memory
         default:
             THROW("Invalid direction");
         }
-        mem_ptr += 2;
-        reg_ptr -= 1;  // Note: Endian
+    }
+
+    if (dir == 0)
+    {
+        state.write(reg_ptr, value);
     }
 }
 
@@ -229,18 +224,26 @@ template <typename T>
 void clr(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    T* ptr = state.get_pointer<T>(ea);
+    auto ptr = state.get_operand<T>(ea);
 
-    state.set_status_bit<bit::negative>(false);
-    state.set_status_bit<bit::zero>(true);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(T(0x0));
 
     state.write(ptr, T(0x0));
 }
 
-struct operation_sub { template <typename T> static T execute(T a, T b) { return a - b; } };
-struct operation_add { template <typename T> static T execute(T a, T b) { return a + b; } };
+struct operation_sub
+{
+    static const flags_op flags = flags_op::sub;
+    template <typename T> static T execute(T a, T b) { return a - b; }
+    template <typename T> static T execute_extended(T a, T b, bool x, bool& c, bool& v) { return sub_with_borrow(a, b, x, c, v); }
+};
+
+struct operation_add
+{
+    static const flags_op flags = flags_op::add;
+    template <typename T> static T execute(T a, T b) { return a + b; }
+    template <typename T> static T execute_extended(T a, T b, bool x, bool& c, bool& v) { return add_with_carry(a, b, x, c, v); }
+};
 
 //
 // Helper: ADD, SUB
@@ -252,17 +255,17 @@ INLINE void arithmetic_helper(machine_state& state, uint16_t opcode)
     auto reg = extract_bits<4, 3>(opcode);
     auto ea = extract_bits<10, 6>(opcode);
 
-    T *src, *dst;
+    operand<T> src, dst;
 
     switch (mode)
     {
     case 0: // Write to D register
-        src = state.get_pointer<T>(ea);
-        dst = state.get_pointer<T>(make_effective_address(0, reg));
+        src = state.get_operand<T>(ea);
+        dst = state.get_operand<T>(make_effective_address(0, reg));
         break;
     case 1: // Write to effective address
-        src = state.get_pointer<T>(make_effective_address(0, reg));
-        dst = state.get_pointer<T>(ea);
+        src = state.get_operand<T>(make_effective_address(0, reg));
+        dst = state.get_operand<T>(ea);
         break;
     default:
         THROW("Invalid mode");
@@ -271,24 +274,10 @@ INLINE void arithmetic_helper(machine_state& state, uint16_t opcode)
     auto src_val = state.read<T>(src);
     auto dst_val = state.read<T>(dst);
 
-    typedef traits<T>::higher_precision_type_t high_precision_t;
-
-    high_precision_t result_high_precision = O::template execute<high_precision_t>(
-        high_precision_t(src_val), 
-        high_precision_t(dst_val));
-
-    T result = T(result_high_precision);
+    // Note: The destination is the left hand operand (SUB computes dst - src)
+    T result = O::template execute<T>(dst_val, src_val);
 
-    bool carry = has_carry(result_high_precision);
-    bool negative = is_negative(result);
-    bool zero = (result == 0);
-    bool overflow = has_overflow(src_val, dst_val, result);
-
-    state.set_status_bit<bit::extend>(carry);
-    state.set_status_bit<bit::negative>(negative);
-    state.set_status_bit<bit::zero>(zero);
-    state.set_status_bit<bit::overflow>(overflow);
-    state.set_status_bit<bit::carry>(carry);
+    state.set_flags<O::flags, T>(src_val, dst_val, result);
 
     state.write<T>(dst, result);
 }
@@ -324,30 +313,15 @@ INLINE void arithmetic_imm_helper(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
 
-    T* dst_ptr = state.get_pointer<T>(ea);
+    auto dst_ptr = state.get_operand<T>(ea);
     T dst = state.read(dst_ptr);
 
     typedef traits<T>::extension_word_type_t extension_t;
     auto imm = state.next<extension_t>();
 
-    typedef traits<T>::higher_precision_type_t high_precision_t;
-
-    high_precision_t result_high_precision = O::template execute<high_precision_t>(
-            high_precision_t(dst),
-            high_precision_t(imm));
+    T result = O::template execute<T>(dst, T(imm));
 
-    T result = T(result_high_precision);
-
-    bool carry = has_carry(result_high_precision);
-    bool negative = is_negative(result);
-    bool zero = (result == 0);
-    bool overflow = has_overflow<T>(dst, T(imm), result);
-
-    state.set_status_bit<bit::extend>(carry);
-    state.set_status_bit<bit::negative>(negative);
-    state.set_status_bit<bit::zero>(zero);
-    state.set_status_bit<bit::overflow>(overflow);
-    state.set_status_bit<bit::carry>(carry);
+    state.set_flags<O::flags, T>(T(imm), dst, result);
 
     state.write(dst_ptr, result);
 }
@@ -383,7 +357,7 @@ INLINE void arithmetic_quick_helper(machine_state& state, uint16_t opcode)
     auto data = extract_bits<4, 3>(opcode);
     auto ea = extract_bits<10, 6>(opcode);
 
-    auto ptr = state.get_pointer<T>(ea);
+    auto ptr = state.get_operand<T>(ea);
     auto val = state.read(ptr);
 
     if (is_address_register(uint32_t(ea)))
@@ -392,28 +366,13 @@ INLINE void arithmetic_quick_helper(machine_state& state, uint16_t opcode)
             uint32_t(val),
             uint32_t(data));
 
-        state.write<uint32_t>((uint32_t*)ptr, result);
+        state.write(operand_cast<uint32_t>(ptr), result);
     }
     else
     {
-        typedef traits<T>::higher_precision_type_t high_precision_t;
-
-        high_precision_t result_high_precision = O::template execute<high_precision_t>(
-            high_precision_t(val),
-            high_precision_t(data));
+        T result = O::template execute<T>(val, T(data));
 
-        T result = T(result_high_precision);
-
-        bool carry = has_carry(result_high_precision);
-        bool negative = is_negative(result);
-        bool zero = (result == 0);
-        bool overflow = has_overflow<T>(val, T(data), result);
-
-        state.set_status_bit<bit::extend>(carry);
-        state.set_status_bit<bit::negative>(negative);
-        state.set_status_bit<bit::zero>(zero);
-        state.set_status_bit<bit::overflow>(overflow);
-        state.set_status_bit<bit::carry>(carry);
+        state.set_flags<O::flags, T>(T(data), val, result);
 
         state.write(ptr, result);
     }
@@ -451,8 +410,8 @@ INLINE void arithmetic_address_helper(machine_state& state, uint16_t opcode)
     auto dst_reg = extract_bits<4, 3>(opcode);
     auto src_ea = extract_bits<10, 6>(opcode);
 
-    auto dst_ptr = state.get_pointer<uint32_t>(make_effective_address(1, dst_reg));
-    auto src_ptr = state.get_pointer<T>(src_ea);
+    auto dst_ptr = state.get_operand<uint32_t>(make_effective_address(1, dst_reg));
+    auto src_ptr = state.get_operand<T>(src_ea);
 
     auto dst_val = state.read(dst_ptr);
     auto src_val = state.read(src_ptr);
@@ -495,17 +454,17 @@ INLINE void arithmetic_extended_helper(machine_state& state, uint16_t opcode)
     auto dst_reg = extract_bits<4, 3>(opcode);
     auto src_reg = extract_bits<13, 3>(opcode);
 
-    T *src_ptr, *dst_ptr;
+    operand<T> src_ptr, dst_ptr;
 
     switch (mode)
     {
     case 0: // Data register direct (0)
-        src_ptr = state.get_pointer<T>(make_effective_address(0, src_reg));
-        dst_ptr = state.get_pointer<T>(make_effective_address(0, dst_reg));
+        src_ptr = state.get_operand<T>(make_effective_address(0, src_reg));
+        dst_ptr = state.get_operand<T>(make_effective_address(0, dst_reg));
         break;
     case 1: // Address register indirect with predecrement (4)
-        src_ptr = state.get_pointer<T>(make_effective_address(4, src_reg));
-        dst_ptr = state.get_pointer<T>(make_effective_address(4, dst_reg));
+        src_ptr = state.get_operand<T>(make_effective_address(4, src_reg));
+        dst_ptr = state.get_operand<T>(make_effective_address(4, dst_reg));
         break;
     default:
         THROW("Invalid mode");
@@ -513,30 +472,15 @@ INLINE void arithmetic_extended_helper(machine_state& state, uint16_t opcode)
 
     auto src_val = state.read(src_ptr);
     auto dst_val = state.read(dst_ptr);
-    auto extend = state.get_status_bit<bit::extend>() ? 1 : 0;
+    bool extend = state.get_status_bit<bit::extend>();
+    bool zero = state.get_status_bit<bit::zero>();
 
-    typedef traits<T>::higher_precision_type_t high_precision_t;
+    // Note: The destination is the left hand operand (SUBX computes dst - src - X)
+    bool carry, overflow;
+    T result = O::template execute_extended<T>(dst_val, src_val, extend, carry, overflow);
 
-    high_precision_t tmp = 
-        O::template execute<high_precision_t>(high_precision_t(src_val), high_precision_t(dst_val));
-    
-    high_precision_t result_high_precision =
-        O::template execute<high_precision_t>(high_precision_t(tmp), high_precision_t(extend));
-
-    T result = T(result_high_precision);
-
-    bool carry = has_carry(result_high_precision);
-    bool negative = is_negative(result);
-    bool zero = (result == 0);
-    bool overflow =
-        has_overflow<T>(src_val, dst_val, T(tmp)) ||
-        has_overflow<T>(T(tmp), extend, result);
-
-    state.set_status_bit<bit::extend>(carry);
-    state.set_status_bit<bit::negative>(negative);
-    state.set_status_bit<bit::zero>(zero);
-    state.set_status_bit<bit::overflow>(overflow);
-    state.set_status_bit<bit::carry>(carry);
+    // Note: Z is only ever cleared, so it stays valid across a multi-precision chain
+    state.set_arithmetic_flags(carry, most_significant_bit(result), zero && (result == 0), overflow, carry);
 
     state.write(dst_ptr, result);
 }
@@ -575,10 +519,9 @@ template <typename O>
 INLINE void logical_immediate_to_ccr_helper(machine_state& state, uint16_t opcode)
 {
     auto imm = state.next<uint16_t>();
-    auto ptr = state.get_pointer<uint8_t>(reg::status_register);
-    auto ccr = state.read(ptr);
+    auto ccr = state.get_condition_code_register();
     uint8_t result = O::template execute<uint8_t>(ccr, uint8_t(imm));
-    state.write(ptr, result);
+    state.set_condition_code_register(result);
 }
 
 //
@@ -619,12 +562,9 @@ template <typename O>
 INLINE void logical_immediate_to_sr_helper(machine_state& state, uint16_t opcode)
 {
     auto imm = state.next<uint16_t>();
-
-    CHECK_SUPERVISOR(state);
-    auto ptr = state.get_pointer<uint16_t>(reg::status_register);
-    auto sr = state.read(ptr);
+    auto sr = state.get_status_register();
     uint16_t result = O::template execute<uint16_t>(sr, imm);
-    state.write(ptr, result);
+    state.set_status_register(result);
 }
 
 //
@@ -665,17 +605,14 @@ INLINE void logical_immediate_helper(machine_state& state, uint16_t opcode)
 {
     auto dst_ea = extract_bits<10, 6>(opcode);
 
-    auto ptr = state.get_pointer<T>(dst_ea);
+    auto ptr = state.get_operand<T>(dst_ea);
     auto val = state.read(ptr);
 
     typedef traits<T>::extension_word_type_t extension_t;
     auto imm = state.next<extension_t>();
     T result = O::template execute<T>(val, T(imm));
 
-    state.set_status_bit<bit::negative>(most_significant_bit(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
     state.write(ptr, result);
 }
@@ -719,18 +656,15 @@ void eori(machine_state& state, uint16_t opcode)
 template <uint16_t dir, typename T, typename O>
 INLINE void logical_helper(machine_state& state, uint16_t opcode)
 {
-    auto ptr_reg = state.get_pointer<T>(make_effective_address(0, extract_bits<4, 3>(opcode)));
-    auto ptr_ea = state.get_pointer<T>(extract_bits<10, 6>(opcode));
+    auto ptr_reg = state.get_operand<T>(make_effective_address(0, extract_bits<4, 3>(opcode)));
+    auto ptr_ea = state.get_operand<T>(extract_bits<10, 6>(opcode));
 
     auto val_reg = state.read(ptr_reg);
     auto val_ea = state.read(ptr_ea);
 
     T result = O::template execute<T>(val_reg, val_ea);
 
-    state.set_status_bit<bit::negative>(most_significant_bit(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
     switch (dir)
     {
@@ -786,31 +720,26 @@ template <typename T, bool use_extend>
 INLINE void negate_helper(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    auto ptr = state.get_pointer<T>(ea);
+    auto ptr = state.get_operand<T>(ea);
     auto val = state.read<T>(ptr);
 
-    T extend = (use_extend && state.get_status_bit<bit::extend>()) ? T(1) : T(0);
-
-    val = negate(val);
-    extend = negate(extend);
-
-    typedef traits<T>::higher_precision_type_t high_precition_t;
-
-    high_precition_t result_high_precision = 
-        high_precition_t(val) + 
-        high_precition_t(extend);
+    if (!use_extend)
+    {
+        // Note: NEG is SUB from zero, so it records lazy condition codes like SUB does
+        T result = T(0) - val;
+        state.set_flags<flags_op::sub, T>(val, T(0), result);
+        state.write<T>(ptr, result);
+        return;
+    }
 
-    T result = (T)(result_high_precision);
+    bool extend = state.get_status_bit<bit::extend>();
+    bool zero = state.get_status_bit<bit::zero>();
 
-    bool non_zero = result != 0;
-    bool negative = is_negative(result);
-    bool overflow = has_overflow(val, extend, result);
+    bool borrow, overflow;
+    T result = sub_with_borrow(T(0), val, extend, borrow, overflow);
 
-    state.set_status_bit<bit::extend>(non_zero);
-    state.set_status_bit<bit::negative>(negative);
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(overflow);
-    state.set_status_bit<bit::carry>(non_zero);
+    // Note: Z is only ever cleared, as for ADDX and SUBX
+    state.set_arithmetic_flags(borrow, most_significant_bit(result), zero && (result == 0), overflow, borrow);
 
     state.write<T>(ptr, result);
 }
@@ -847,8 +776,8 @@ INLINE void divide_helper(machine_state& state, uint16_t opcode)
 {
     // Denominator (16 bits)
     auto denom_ea = extract_bits<10, 6>(opcode);
-    auto denom_ptr = state.get_pointer<uint16_t>(denom_ea);
-    auto denom_val = state.read<TDenom>((TDenom*)denom_ptr);
+    auto denom_ptr = state.get_operand<uint16_t>(denom_ea);
+    auto denom_val = state.read(operand_cast<TDenom>(denom_ptr));
 
     // Always clear carry flag
     state.set_status_bit<bit::carry>(false);
@@ -861,8 +790,8 @@ INLINE void divide_helper(machine_state& state, uint16_t opcode)
     {
         // Numerator (32 bits)
         auto num_reg = extract_bits<4, 3>(opcode);
-        auto num_ptr = state.get_pointer<uint32_t>(make_effective_address(0, num_reg));
-        auto num_val = state.read<TNum>((TNum*)num_ptr);
+        auto num_ptr = state.get_operand<uint32_t>(make_effective_address(0, num_reg));
+        auto num_val = state.read(operand_cast<TNum>(num_ptr));
 
         // Divide
         auto quotient = num_val / TNum(denom_val);
@@ -883,7 +812,7 @@ INLINE void divide_helper(machine_state& state, uint16_t opcode)
             state.set_status_bit<bit::zero>(quotient == 0);
 
             // Write result
-            state.write<uint32_t>((uint32_t*)num_ptr, result);
+            state.write(num_ptr, result);
         }
     }
 }
@@ -917,8 +846,8 @@ void jmp(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
     
-    uint32_t* jump_to_ptr = state.get_pointer<uint32_t>(ea);
-    uint32_t jump_to = state.read(jump_to_ptr);
+    auto jump_to_ptr = state.get_operand<uint32_t>(ea);
+    uint32_t jump_to = state.get_address(jump_to_ptr);
 
     state.set_program_counter(jump_to);
 }
@@ -932,8 +861,8 @@ void jsr(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
 
-    uint32_t* jump_to_ptr = state.get_pointer<uint32_t>(ea);
-    uint32_t jump_to = state.read(jump_to_ptr);
+    auto jump_to_ptr = state.get_operand<uint32_t>(ea);
+    uint32_t jump_to = state.get_address(jump_to_ptr);
 
     state.push_program_counter();
     state.set_program_counter(jump_to);
@@ -970,9 +899,7 @@ void rtr(machine_state& state, uint16_t opcode)
 
 void rte(machine_state& state, uint16_t opcode)
 {
-    CHECK_SUPERVISOR(state);
-    state.pop_status_register();
-    state.pop_program_counter();
+    state.pop_exception_frame();
 }
 
 //
@@ -984,12 +911,12 @@ void link(machine_state& state, uint16_t opcode)
 {
     // The contents of the specified address register is pushed onto the stack
     auto reg = extract_bits<13, 3>(opcode);
-    auto ptr = state.get_pointer<uint32_t>(make_effective_address(1, reg));
+    auto ptr = state.get_operand<uint32_t>(make_effective_address(1, reg));
     auto val = state.read<uint32_t>(ptr);
     state.push<uint32_t>(val);
 
     // Then, the address register is loaded with the updated stack pointer
-    auto stack_ptr_ptr = state.get_pointer<uint32_t>(make_effective_address(1, 7));
+    auto stack_ptr_ptr = state.get_operand<uint32_t>(make_effective_address(1, 7));
     auto stack_ptr = state.read<uint32_t>(stack_ptr_ptr);
     state.write<uint32_t>(ptr, stack_ptr);
 
@@ -1009,11 +936,11 @@ void unlk(machine_state& state, uint16_t opcode)
 {
     // The stack pointer is loaded from the specified address register...
     auto reg = extract_bits<13, 3>(opcode);
-    auto ptr = state.get_pointer<uint32_t>(make_effective_address(1, reg));
+    auto ptr = state.get_operand<uint32_t>(make_effective_address(1, reg));
     auto new_stack_ptr = state.read<uint32_t>(ptr);
 
     // ... and the old contents of the stack pointer is lost
-    auto stack_ptr_ptr = state.get_pointer<uint32_t>(make_effective_address(1, 7));
+    auto stack_ptr_ptr = state.get_operand<uint32_t>(make_effective_address(1, 7));
     state.write<uint32_t>(stack_ptr_ptr, new_stack_ptr);
 
     // The address register is then loaded with the longword pulled off the stack.
@@ -1022,18 +949,29 @@ void unlk(machine_state& state, uint16_t opcode)
 }
 
 //
-// BRA
-// Branch always
+// Helper: BRA, BSR, Bcc
+// Reads the 8-bit displacement, or the 16-bit extension word when that is 0, as an offset from the PC after the instruction
 //
 
-void bra(machine_state& state, uint16_t opcode)
+INLINE int32_t branch_displacement(machine_state& state, uint16_t opcode)
 {
     int32_t displacement = int8_t(extract_bits<8, 8>(opcode));
     if (displacement == 0)
     {
-        displacement = int32_t(state.next<int16_t>());
+        // Note: The displacement counts from the extension word, which next() has already stepped over
+        displacement = int32_t(state.next<int16_t>()) - int32_t(sizeof(int16_t));
     }
-    state.offset_program_counter(displacement);
+    return displacement;
+}
+
+//
+// BRA
+// Branch always
+//
+
+void bra(machine_state& state, uint16_t opcode)
+{
+    state.offset_program_counter(branch_displacement(state, opcode));
 }
 
 //
@@ -1043,11 +981,7 @@ void bra(machine_state& state, uint16_t opcode)
 
 void bsr(machine_state& state, uint16_t opcode)
 {
-    int32_t displacement = int8_t(extract_bits<8, 8>(opcode));
-    if (displacement == 0)
-    {
-        displacement = int32_t(state.next<int16_t>());
-    }
+    int32_t displacement = branch_displacement(state, opcode);
     state.push_program_counter();
     state.offset_program_counter(displacement);
 }
@@ -1083,9 +1017,65 @@ void trapv(machine_state& state, uint16_t opcode)
 
 void illegal(machine_state& state, uint16_t opcode)
 {
+    state.offset_program_counter(-int32_t(sizeof(uint16_t))); // Note: The stacked PC points at the illegal instruction itself
     state.exception(4 /* Illegal instruction */);
 }
 
+//
+// PRIVILEGE VIOLATION
+// Privileged instruction executed in user mode (only reachable through the user mode opcode table)
+//
+
+void privilege_violation(machine_state& state, uint16_t opcode)
+{
+    state.offset_program_counter(-int32_t(sizeof(uint16_t))); // Note: The stacked PC points at the privileged instruction itself
+    state.exception(8 /* Privilege violation */);
+}
+
+//
+// TRACE
+// Runs an instruction with SR.T set, then raises a trace exception (only reachable through the trace opcode table)
+//
+
+void trace(machine_state& state, uint16_t opcode)
+{
+    state.clear_last_exception();
+    state.execute_untraced(opcode);
+
+    // Note: Illegal, privileged and line A/F opcodes are not executed, so they are not traced. Other exceptions raised by
+    // the instruction itself (TRAP, TRAPV, CHK, division by zero) clear SR.T, the trace exception then follows their frame.
+    switch (state.get_last_exception())
+    {
+    case 4:     // Illegal instruction
+    case 8:     // Privilege violation
+    case 10:    // Line 1010 emulator
+    case 11:    // Line 1111 emulator
+        return;
+    }
+
+    if (!state.is_stopped())
+    {
+        state.exception(9 /* Trace exception */);
+    }
+}
+
+//
+// Line A and line F emulators
+// Unassigned opcodes starting with 1010 and 1111 (used by some systems to trap into the OS or a coprocessor)
+//
+
+void line_a(machine_state& state, uint16_t opcode)
+{
+    state.offset_program_counter(-int32_t(sizeof(uint16_t)));
+    state.exception(10 /* Line 1010 emulator */);
+}
+
+void line_f(machine_state& state, uint16_t opcode)
+{
+    state.offset_program_counter(-int32_t(sizeof(uint16_t)));
+    state.exception(11 /* Line 1111 emulator */);
+}
+
 struct operation_btst { static uint32_t execute(uint32_t val, uint32_t bit_index) { return val; } };
 struct operation_bchg { static uint32_t execute(uint32_t val, uint32_t bit_index) { return val ^ (1 << bit_index); } };
 struct operation_bclr { static uint32_t execute(uint32_t val, uint32_t bit_index) { return val & (~(1 << bit_index)); } };
@@ -1110,7 +1100,7 @@ INLINE void bitop_helper(machine_state& state, uint16_t opcode)
     case 1: // Data register
     {
         auto src_reg = extract_bits<4, 3>(opcode);
-        uint32_t* ptr = state.get_pointer<uint32_t>(make_effective_address(0, src_reg));
+        auto ptr = state.get_operand<uint32_t>(make_effective_address(0, src_reg));
         bit_index = state.read(ptr);
     }
     break;
@@ -1125,7 +1115,7 @@ INLINE void bitop_helper(machine_state& state, uint16_t opcode)
     static uint32_t modulo[8] = { 0x1f, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7 }; // Modulo 32 for data registers, otherwise module 8 (for memory locations)
     bit_index &= modulo[dst_mode];
 
-    uint32_t* dst_ptr = state.get_pointer<uint32_t>(dst_ea);
+    auto dst_ptr = state.get_operand<uint32_t>(dst_ea);
     uint32_t dst = state.read(dst_ptr);
 
     auto result = O::template execute(dst, bit_index);
@@ -1190,14 +1180,11 @@ void _not(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
 
-    auto ptr = state.get_pointer<T>(ea);
+    auto ptr = state.get_operand<T>(ea);
     T value = state.read(ptr);
     T result = ~value;
 
-    state.set_status_bit<bit::negative>(is_negative(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
     state.write<T>(ptr, result);
 }
@@ -1213,10 +1200,10 @@ void lea(machine_state& state, uint16_t opcode)
     auto dst_reg = extract_bits<4, 3>(opcode);
     auto src_ea = extract_bits<10, 6>(opcode);
 
-    uint32_t* src_ptr = state.get_pointer<uint32_t>(src_ea);
-    uint32_t* dst_ptr = state.get_pointer<uint32_t>(make_effective_address(1 /* Address register direct */, dst_reg));
+    auto src_ptr = state.get_operand<uint32_t>(src_ea);
+    auto dst_ptr = state.get_operand<uint32_t>(make_effective_address(1 /* Address register direct */, dst_reg));
 
-    uint32_t offset = state.pointer_to_memory_offset(src_ptr);
+    uint32_t offset = state.get_address(src_ptr);
     state.write(dst_ptr, offset);
 }
 
@@ -1229,9 +1216,9 @@ void pea(machine_state& state, uint16_t opcode)
 {
     auto src_ea = extract_bits<10, 6>(opcode);
 
-    uint32_t* src_ptr = state.get_pointer<uint32_t>(src_ea);
+    auto src_ptr = state.get_operand<uint32_t>(src_ea);
 
-    uint32_t offset = state.pointer_to_memory_offset(src_ptr);
+    uint32_t offset = state.get_address(src_ptr);
     state.push(offset);
 }
 
@@ -1243,11 +1230,11 @@ void pea(machine_state& state, uint16_t opcode)
 void chk(machine_state& state, uint16_t opcode)
 {
     auto value_reg = extract_bits<4, 3>(opcode);
-    int16_t* value_ptr = (int16_t*)state.get_pointer<uint16_t>(make_effective_address(0 /* Data register direct */, value_reg));
-    int16_t value = state.read(value_ptr);
+    auto value_ptr = state.get_operand<uint16_t>(make_effective_address(0 /* Data register direct */, value_reg));
+    int16_t value = int16_t(state.read(value_ptr));
 
     auto src_ea = extract_bits<10, 6>(opcode);
-    auto src_ptr = state.get_pointer<uint16_t>(src_ea);
+    auto src_ptr = state.get_operand<uint16_t>(src_ea);
     auto upper_bound = state.read(src_ptr);
 
     if (value < 0 || value > upper_bound)
@@ -1265,10 +1252,7 @@ INLINE void cmp_helper(machine_state& state, T a, T b)
 {
     T result = a - b;
 
-    state.set_status_bit<bit::negative>(is_negative<T>(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(has_overflow(a, b, result));
-    state.set_status_bit<bit::carry>(has_borrow<T>(a, b));
+    state.set_flags<flags_op::cmp, T>(b, a, result);
 }
 
 //
@@ -1280,7 +1264,7 @@ template <typename T>
 void cmpi(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    T* ptr = state.get_pointer<T>(ea);
+    auto ptr = state.get_operand<T>(ea);
     T value = state.read(ptr);
 
     typedef traits<T>::extension_word_type_t extension_t;
@@ -1301,8 +1285,8 @@ void cmpm(machine_state& state, uint16_t opcode)
     auto dst_reg = extract_bits<4, 3>(opcode);
  
     // Note: Address register indirect with postincrement
-    auto src_ptr = state.get_pointer<T>(make_effective_address(3, src_reg));
-    auto dst_ptr = state.get_pointer<T>(make_effective_address(3, dst_reg));
+    auto src_ptr = state.get_operand<T>(make_effective_address(3, src_reg));
+    auto dst_ptr = state.get_operand<T>(make_effective_address(3, dst_reg));
  
     T src_val = state.read<T>(src_ptr);
     T dst_val = state.read<T>(dst_ptr);
@@ -1321,8 +1305,8 @@ void cmpa(machine_state& state, uint16_t opcode)
     auto src_ea = extract_bits<10, 6>(opcode);
     auto dst_reg = extract_bits<4, 3>(opcode);
 
-    T* src_ptr = state.get_pointer<T>(src_ea);
-    uint32_t* dst_ptr = state.get_pointer<uint32_t>(make_effective_address(1, dst_reg));
+    auto src_ptr = state.get_operand<T>(src_ea);
+    auto dst_ptr = state.get_operand<uint32_t>(make_effective_address(1, dst_reg));
 
     uint32_t src_val = sign_extend<T>(state.read<T>(src_ptr));
     uint32_t dst_val = state.read<uint32_t>(dst_ptr);
@@ -1341,8 +1325,8 @@ void cmp(machine_state& state, uint16_t opcode)
     auto src_ea = extract_bits<10, 6>(opcode);
     auto dst_reg = extract_bits<4, 3>(opcode);
 
-    auto src_ptr = state.get_pointer<T>(src_ea);
-    auto dst_ptr = state.get_pointer<T>(make_effective_address(0, dst_reg));
+    auto src_ptr = state.get_operand<T>(src_ea);
+    auto dst_ptr = state.get_operand<T>(make_effective_address(0, dst_reg));
 
     auto src_val = state.read(src_ptr);
     auto dst_val = state.read(dst_ptr);
@@ -1361,17 +1345,14 @@ void ext(machine_state& state, uint16_t opcode)
     auto reg = extract_bits<13, 3>(opcode);
 
     typedef traits<T>::lower_precision_type_t low_precision_t;
-    low_precision_t* ptr = state.get_pointer<low_precision_t>(make_effective_address(0, reg));
+    auto ptr = state.get_operand<low_precision_t>(make_effective_address(0, reg));
     low_precision_t value = state.read<low_precision_t>(ptr);
 
     T result = T(sign_extend<low_precision_t>(value));
 
-    state.set_status_bit<bit::negative>(is_negative<T>(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
-    state.write<T>((T*)ptr, result);
+    state.write(operand_cast<T>(ptr), result);
 }
 
 //
@@ -1383,14 +1364,11 @@ void swap(machine_state& state, uint16_t opcode)
 {
     auto reg = extract_bits<13, 3>(opcode);
 
-    uint32_t* ptr = state.get_pointer<uint32_t>(make_effective_address(0, reg));
+    auto ptr = state.get_operand<uint32_t>(make_effective_address(0, reg));
     uint32_t value = state.read<uint32_t>(ptr);
     uint32_t result = (value >> 16) | (value << 16);
 
-    state.set_status_bit<bit::negative>(most_significant_bit(result));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(result);
 
     state.write<uint32_t>(ptr, result);
 }
@@ -1404,13 +1382,10 @@ void tas(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
     
-    auto ptr = state.get_pointer<uint8_t>(ea);
+    auto ptr = state.get_operand<uint8_t>(ea);
     auto val = state.read<uint8_t>(ptr);
 
-    state.set_status_bit<bit::negative>(most_significant_bit(val));
-    state.set_status_bit<bit::zero>(val == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(val);
 
     val |= (1 << 7);
 
@@ -1427,13 +1402,10 @@ void tst(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
     
-    auto ptr = state.get_pointer<T>(ea);
+    auto ptr = state.get_operand<T>(ea);
     auto val = state.read<T>(ptr);
 
-    state.set_status_bit<bit::negative>(is_negative(val));
-    state.set_status_bit<bit::zero>(val == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(val);
 }
 
 //
@@ -1489,8 +1461,8 @@ void exg(machine_state& state, uint16_t opcode)
     auto reg1 = extract_bits<4, 3>(opcode);
     auto reg2 = extract_bits<13, 3>(opcode);
 
-    auto ptr1 = state.get_pointer<uint32_t>(make_effective_address(mode1, reg1));
-    auto ptr2 = state.get_pointer<uint32_t>(make_effective_address(mode2, reg2));
+    auto ptr1 = state.get_operand<uint32_t>(make_effective_address(mode1, reg1));
+    auto ptr2 = state.get_operand<uint32_t>(make_effective_address(mode2, reg2));
 
     auto val1 = state.read<uint32_t>(ptr1);
     auto val2 = state.read<uint32_t>(ptr2);
@@ -1507,14 +1479,7 @@ void exg(machine_state& state, uint16_t opcode)
 void stop(machine_state& state, uint16_t opcode)
 {
     auto imm = state.next<uint16_t>();
-
-    CHECK_SUPERVISOR(state);
-
-    if (state.get_status_bit<bit::trace>())
-    {
-        state.exception(9 /* Trace exception */);
-        return;
-    }
+    bool traced = state.get_status_bit<bit::trace>();
 
     bool mode_change_attempt = (imm & (1 << uint32_t(bit::supervisor))) == 0;
 
@@ -1524,10 +1489,13 @@ void stop(machine_state& state, uint16_t opcode)
         return;
     }
 
-    auto ptr = state.get_pointer<uint16_t>(reg::status_register);
-    state.write<uint16_t>(ptr, imm);
+    state.set_status_register(imm);
 
-    state.stop();
+    // Note: A traced STOP does not halt, the trace exception is taken instead (see trace())
+    if (!traced)
+    {
+        state.stop();
+    }
 }
 
 //
@@ -1537,10 +1505,12 @@ void stop(machine_state& state, uint16_t opcode)
 template <uint16_t condition>
 INLINE bool evaluate_condition(machine_state& state)
 {
-    bool c = state.get_status_bit<bit::carry>();
-    bool z = state.get_status_bit<bit::zero>();
-    bool n = state.get_status_bit<bit::negative>();
-    bool v = state.get_status_bit<bit::overflow>();
+    // Note: Computes the condition codes from the lazy flags, but leaves them pending
+    auto ccr = state.get_condition_code_register();
+    bool c = (ccr & (1 << uint32_t(bit::carry))) != 0;
+    bool z = (ccr & (1 << uint32_t(bit::zero))) != 0;
+    bool n = (ccr & (1 << uint32_t(bit::negative))) != 0;
+    bool v = (ccr & (1 << uint32_t(bit::overflow))) != 0;
 
     switch (condition)
     {
@@ -1574,7 +1544,7 @@ template <uint16_t condition>
 void scc(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    auto ptr = state.get_pointer<uint8_t>(ea);
+    auto ptr = state.get_operand<uint8_t>(ea);
 
     bool result = evaluate_condition<condition>(state);
     state.write<uint8_t>(ptr, uint8_t(result ? 0xff : 0x00));
@@ -1588,15 +1558,11 @@ void scc(machine_state& state, uint16_t opcode)
 template <uint16_t condition>
 void bcc(machine_state& state, uint16_t opcode)
 {
-    bool result = evaluate_condition<condition>(state);
+    // Note: The extension word is stepped over whether or not the branch is taken
+    int32_t displacement = branch_displacement(state, opcode);
 
-    if (result)
+    if (evaluate_condition<condition>(state))
     {
-        int32_t displacement = int8_t(extract_bits<8, 8>(opcode));
-        if (displacement == 0)
-        {
-            displacement = int32_t(state.next<int16_t>());
-        }
         state.offset_program_counter(displacement);
     }
 }
@@ -1610,13 +1576,14 @@ template <uint16_t condition>
 void dbcc(machine_state& state, uint16_t opcode)
 {
     bool result = evaluate_condition<condition>(state);
-    auto displacement = int32_t(state.next<int16_t>());
-    
-    if (result)
+    auto displacement = int32_t(state.next<int16_t>()) - int32_t(sizeof(int16_t)); // Note: Counts from the extension word
+
+    // Note: A true condition ends the loop without touching the counter
+    if (!result)
     {
         auto reg = extract_bits<13, 3>(opcode);
-        uint16_t* ptr = state.get_pointer<uint16_t>(make_effective_address(0, reg));
-        int16_t val = state.read<int16_t>((int16_t*)ptr) - int16_t(1);
+        auto ptr = state.get_operand<uint16_t>(make_effective_address(0, reg));
+        int16_t val = int16_t(state.read(ptr)) - int16_t(1);
         state.write(ptr, uint16_t(val));
 
         if (val != -1)
@@ -1635,20 +1602,17 @@ INLINE void mul_helper(machine_state& state, uint16_t opcode)
     auto src_ea = extract_bits<10, 6>(opcode);
     auto dst_reg = extract_bits<4, 3>(opcode);
 
-    auto src_ptr = state.get_pointer<uint16_t>(src_ea);
-    auto dst_ptr = state.get_pointer<uint16_t>(make_effective_address(0, dst_reg));
+    auto src_ptr = state.get_operand<uint16_t>(src_ea);
+    auto dst_ptr = state.get_operand<uint16_t>(make_effective_address(0, dst_reg));
 
     TOperand src_val = TOperand(state.read(src_ptr));
     TOperand dst_val = TOperand(state.read(dst_ptr));
 
     TResult result = TResult(src_val) * TResult(dst_val);
 
-    state.set_status_bit<bit::negative>(is_negative(uint32_t(result)));
-    state.set_status_bit<bit::zero>(result == 0);
-    state.set_status_bit<bit::overflow>(false);
-    state.set_status_bit<bit::carry>(false);
+    state.set_logic_flags(uint32_t(result));
 
-    state.write<uint32_t>((uint32_t*)dst_ptr, result);
+    state.write(operand_cast<uint32_t>(dst_ptr), uint32_t(result));
 }
 
 //
@@ -1724,7 +1688,7 @@ template <uint16_t direction>
 void asx_mem(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    auto ptr = state.get_pointer<uint16_t>(ea);
+    auto ptr = state.get_operand<uint16_t>(ea);
     auto val = int16_t(state.read(ptr));
     auto msr_before = most_significant_bit(val);
 
@@ -1757,7 +1721,7 @@ template <uint16_t direction>
 void lsx_mem(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    auto ptr = state.get_pointer<uint16_t>(ea);
+    auto ptr = state.get_operand<uint16_t>(ea);
     auto val = state.read<uint16_t>(ptr);
 
     bool last_out;
@@ -1786,7 +1750,7 @@ void lsx_mem(machine_state& state, uint16_t opcode)
 template <uint16_t direction>
 void roxx_mem(machine_state& state, uint16_t opcode)
 {
-    THROW("ROXx not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1798,7 +1762,7 @@ template <uint16_t direction>
 void rox_mem(machine_state& state, uint16_t opcode)
 {
     auto ea = extract_bits<10, 6>(opcode);
-    auto ptr = state.get_pointer<uint16_t>(ea);
+    auto ptr = state.get_operand<uint16_t>(ea);
     auto val = state.read<uint16_t>(ptr);
 
     bool last_out;
@@ -1826,7 +1790,7 @@ void rox_mem(machine_state& state, uint16_t opcode)
 template <uint16_t direction, typename T, uint16_t mode>
 void asx_reg(machine_state& state, uint16_t opcode)
 {
-    THROW("ASx not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1837,7 +1801,7 @@ void asx_reg(machine_state& state, uint16_t opcode)
 template <uint16_t direction, typename T, uint16_t mode>
 void lsx_reg(machine_state& state, uint16_t opcode)
 {
-    THROW("LSx not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1848,7 +1812,7 @@ void lsx_reg(machine_state& state, uint16_t opcode)
 template <uint16_t direction, typename T, uint16_t mode>
 void roxx_reg(machine_state& state, uint16_t opcode)
 {
-    THROW("ROXx not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1859,7 +1823,7 @@ void roxx_reg(machine_state& state, uint16_t opcode)
 template <uint16_t direction, typename T, uint16_t mode>
 void rox_reg(machine_state& state, uint16_t opcode)
 {
-    THROW("ROx not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1869,7 +1833,7 @@ void rox_reg(machine_state& state, uint16_t opcode)
 
 void nbcd(machine_state& state, uint16_t opcode)
 {
-    THROW("NBCD not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1880,7 +1844,7 @@ void nbcd(machine_state& state, uint16_t opcode)
 template <uint16_t mode>
 void sbcd(machine_state& state, uint16_t opcode)
 {
-    THROW("SBCD not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
 }
 
 //
@@ -1891,5 +1855,92 @@ void sbcd(machine_state& state, uint16_t opcode)
 template <uint16_t mode>
 void abcd(machine_state& state, uint16_t opcode)
 {
-    THROW("ABCD not implemented");
+    state.raise_fault(fault::unimplemented_instruction);
+}
+
+//
+// Pre-decoded operand forms
+// Variants of a few hot instruction forms that take their extension words from the pre-decoded record (see
+// machine_state::next_decoded()) instead of fetching them from memory. Only run_predecoded() runs them, see
+// get_decoded_operand_handler() for the forms covered.
+//
+
+template <typename T>
+void move_immediate_decoded(machine_state& state, uint16_t opcode)
+{
+    typedef traits<T>::extension_word_type_t extension_t;
+    T result = T(state.next_decoded<extension_t>());
+
+    auto reg = extract_bits<4, 3>(opcode);
+    auto dst_ptr = state.get_operand<T>(make_effective_address(0, reg));
+
+    state.set_logic_flags(result);
+
+    state.write(dst_ptr, result);
+}
+
+template <typename T, typename O>
+void arithmetic_immediate_decoded(machine_state& state, uint16_t opcode)
+{
+    auto reg = extract_bits<13, 3>(opcode);
+    auto dst_ptr = state.get_operand<T>(make_effective_address(0, reg));
+    T dst = state.read(dst_ptr);
+
+    typedef traits<T>::extension_word_type_t extension_t;
+    auto imm = state.next_decoded<extension_t>();
+
+    T result = O::template execute<T>(dst, T(imm));
+
+    state.set_flags<O::flags, T>(T(imm), dst, result);
+
+    state.write(dst_ptr, result);
+}
+
+template <typename T>
+void cmpi_decoded(machine_state& state, uint16_t opcode)
+{
+    auto reg = extract_bits<13, 3>(opcode);
+    auto ptr = state.get_operand<T>(make_effective_address(0, reg));
+    T value = state.read(ptr);
+
+    typedef traits<T>::extension_word_type_t extension_t;
+    extension_t imm = state.next_decoded<extension_t>();
+
+    cmp_helper<T>(state, value, T(imm));
+}
+
+void bra_decoded(machine_state& state, uint16_t opcode)
+{
+    state.offset_program_counter(int32_t(state.next_decoded<int16_t>()) - int32_t(sizeof(int16_t)));
+}
+
+template <uint16_t condition>
+void bcc_decoded(machine_state& state, uint16_t opcode)
+{
+    int32_t displacement = int32_t(state.next_decoded<int16_t>()) - int32_t(sizeof(int16_t));
+
+    if (evaluate_condition<condition>(state))
+    {
+        state.offset_program_counter(displacement);
+    }
+}
+
+template <uint16_t condition>
+void dbcc_decoded(machine_state& state, uint16_t opcode)
+{
+    bool result = evaluate_condition<condition>(state);
+    auto displacement = int32_t(state.next_decoded<int16_t>()) - int32_t(sizeof(int16_t));
+
+    if (!result)
+    {
+        auto reg = extract_bits<13, 3>(opcode);
+        auto ptr = state.get_operand<uint16_t>(make_effective_address(0, reg));
+        int16_t val = int16_t(state.read(ptr)) - int16_t(1);
+        state.write(ptr, uint16_t(val));
+
+        if (val != -1)
+        {
+            state.offset_program_counter(displacement);
+        }
+    }
 }
\ No newline at end of file
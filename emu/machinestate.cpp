@@ -1,90 +1,672 @@
 #include <stack>
 #include <bitset>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
 
 #include "common.h"
 #include "machinestate.h"
 #include "opcodes.h"
+#include "platform.h"
 
-machine_state::machine_state()
-    : m_storage_index(0)
+#if HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+machine_state::machine_state(const memory_config& config)
+    : m_memory_size(size_t(1) << config.address_bits)
+    , m_address_mask(uint32_t(m_memory_size - 1))
+    , m_opcode_table(get_user_opcode_table()) // Note: SR is cleared until a program is loaded
+    , m_supervisor_table(get_opcode_table())
+    , m_user_table(get_user_opcode_table())
+    , m_trace_table(get_trace_opcode_table())
+    , m_block_end_table(get_block_end_table())
+    , m_decoded(nullptr)
+    , m_instruction_count(0)
+    , m_stopped(false)
+    , m_exit_requested(false)
+    , m_fault(fault::none)
+    , m_last_exception(0)
+    , m_dispatch_mode(dispatch_mode::table)
+    , m_large_pages(false)
 {
-    m_memory_size = size_t(std::pow(int32_t(2), int32_t(24)));
-    m_memory = (uint8_t*)::malloc(m_memory_size);
-    IF_FALSE_THROW(m_memory != nullptr, "Allocation failed");
-    ::memset(m_memory, 0x0, m_memory_size);
-    ::memset(&m_registers, 0x0, sizeof(m_registers));
-    ::memset(m_storage, 0x0, sizeof(m_storage));
+    IF_FALSE_THROW(config.address_bits >= memory_bus::page_bits && config.address_bits <= 32, "Invalid address bus width: " << config.address_bits);
 
-    make_opcode_table(m_opcode_table);
+    // Note: Guest addresses are masked into the address space, so nothing in range is ever checked. The guard regions make
+    // a host side access that runs past either end (an emulator bug) crash on the spot instead of corrupting the heap.
+    // Committed memory is zero filled by the host on first touch, so only the pages a guest uses are ever backed. Memory
+    // starts on a large page boundary, so all of it can be backed by large pages (see enable_large_pages()).
+    m_reservation_size = m_memory_size + 2 * memory_guard_size + large_page_size;
+    m_reservation = (uint8_t*)reserve_memory(m_reservation_size);
+    m_memory = (uint8_t*)((uintptr_t(m_reservation) + memory_guard_size + large_page_size - 1) & ~uintptr_t(large_page_size - 1));
+    m_bus.attach_memory(m_memory, m_memory_size);
+    map_ram(0, config.ram_size);
+    ::memset(&m_registers, 0x0, sizeof(m_registers));
+    ::memset(&m_flags, 0x0, sizeof(m_flags));
 }
 
 machine_state::~machine_state()
 {
-    if (m_memory)
+    if (m_reservation)
     {
-        ::free(m_memory);
+        release_memory(m_reservation, m_reservation_size);
     }
 }
 
 void machine_state::load_program(size_t memory_offset, void* program, size_t program_size, uint32_t init_pc)
+{
+    clear_memory();
+    copy_to_memory(memory_offset, program, program_size);
+    reset_cpu(init_pc);
+}
+
+void machine_state::load_program_file(size_t memory_offset, const char* path, uint32_t init_pc, bool map)
+{
+    clear_memory();
+    if (map)
+    {
+        map_file_to_memory(memory_offset, path);
+    }
+    else
+    {
+        copy_file_to_memory(memory_offset, path);
+    }
+    reset_cpu(init_pc);
+}
+
+void machine_state::reset_cpu(uint32_t init_pc)
 {
     ::memset(&m_registers, 0x0, sizeof(m_registers));
-    ::memcpy(&m_memory[memory_offset], program, program_size);
+    m_flags.op = flags_op::none;
     set_program_counter(init_pc);
     set_status_bit<bit::supervisor>(true); // Initialize the CPU in supervisor mode
+    m_stopped = false;
+    m_exit_requested = false;
+    m_fault = fault::none;
+}
+
+void machine_state::clear_memory()
+{
+    // Note: The pages are handed back to the host rather than overwritten, so a cleared machine costs no memory until it
+    // runs. Only RAM and ROM pages are committed, each run of them is discarded with a single call.
+    size_t run_start = 0;
+    size_t run_size = 0;
+    for (size_t address = 0; address < m_memory_size; address += memory_bus::page_size)
+    {
+        if (m_bus.get_read_page(uint32_t(address)) != nullptr)
+        {
+            run_start = (run_size == 0) ? address : run_start;
+            run_size += memory_bus::page_size;
+        }
+        else if (run_size != 0)
+        {
+            discard_memory_range(run_start, run_size);
+            run_size = 0;
+        }
+    }
+    if (run_size != 0)
+    {
+        discard_memory_range(run_start, run_size);
+    }
+    m_decode_cache.invalidate_all();
+}
+
+void machine_state::discard_memory_range(size_t address, size_t size)
+{
+    discard_memory(&m_memory[address], size);
+    if (m_large_pages)
+    {
+        advise_large_pages(&m_memory[address], size);
+    }
+}
+
+// Bytes of RAM and ROM from 'address' on, up to the first page that is not backed by host memory
+size_t machine_state::get_memory_extent(size_t address)
+{
+    size_t end = address & ~size_t(memory_bus::page_mask);
+    while (end < m_memory_size && m_bus.get_read_page(uint32_t(end)) != nullptr)
+    {
+        end += memory_bus::page_size;
+    }
+    return (end > address) ? end - address : 0;
+}
+
+bool machine_state::enable_large_pages()
+{
+    m_large_pages = advise_large_pages(m_memory, m_memory_size);
+    return m_large_pages;
+}
+
+void machine_state::copy_to_memory(size_t memory_offset, const void* src, size_t size)
+{
+    IF_FALSE_THROW(size <= get_memory_extent(memory_offset), "Program does not fit in memory at 0x" << std::hex << memory_offset);
+    const uint8_t* src_bytes = (const uint8_t*)src;
+
+#if NATIVE_ENDIAN_MEMORY
+    // Convert the big-endian image to the word swapped layout
+    size_t i = 0;
+    if ((memory_offset & 0x1) == 0)
+    {
+#if HAS_SSE2
+        // Note: Swaps the bytes of eight words at a time, the layout is per word so this only needs an even start
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i words = _mm_loadu_si128((const __m128i*)&src_bytes[i]);
+            words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+            _mm_storeu_si128((__m128i*)&m_memory[memory_offset + i], words);
+        }
+#else
+        // Note: One word at a time on hosts without SSE2 (e.g. ARM64)
+        for (; i + sizeof(uint16_t) <= size; i += sizeof(uint16_t))
+        {
+            uint16_t word = uint16_t((src_bytes[i] << 8) | src_bytes[i + 1]);
+            ::memcpy(&m_memory[memory_offset + i], &word, sizeof(word));
+        }
+#endif
+    }
+    for (; i < size; i++)
+    {
+        m_memory[(memory_offset + i) ^ 1] = src_bytes[i];
+    }
+#else
+    ::memcpy(&m_memory[memory_offset], src_bytes, size);
+#endif
+
+    // Note: The copy bypasses write_memory(), so code decoded or recorded from the old contents is dropped here
+    m_decode_cache.invalidate_all();
+}
+
+void machine_state::copy_file_to_memory(size_t memory_offset, const char* path)
+{
+#if NATIVE_ENDIAN_MEMORY
+    // Note: The image has to be converted to the word swapped layout, so it is read and copied
+    std::vector<uint8_t> image = read_file(path);
+    copy_to_memory(memory_offset, image.data(), image.size());
+#else
+    size_t extent = get_memory_extent(memory_offset);
+    IF_FALSE_THROW(extent > 0, "No memory at 0x" << std::hex << memory_offset << " to load " << path);
+    load_file(&m_memory[memory_offset], extent, path);
+    m_decode_cache.invalidate_all();
+#endif
+}
+
+void machine_state::map_file_to_memory(size_t memory_offset, const char* path)
+{
+#if NATIVE_ENDIAN_MEMORY
+    // Note: The image has to be converted to the word swapped layout, so it can not be mapped
+    copy_file_to_memory(memory_offset, path);
+#else
+    // Note: Mapped copy-on-write where the host allows it, so instances loading the same file share its pages
+    size_t extent = get_memory_extent(memory_offset);
+    IF_FALSE_THROW(extent > 0, "No memory at 0x" << std::hex << memory_offset << " to load " << path);
+    map_file(&m_memory[memory_offset], extent, path);
+    m_decode_cache.invalidate_all();
+#endif
+}
+
+void machine_state::map_ram(uint32_t address, size_t size)
+{
+    m_bus.map_ram(address, size);
+    commit_memory(&m_memory[address], size);
+    m_decode_cache.invalidate_all();
+}
+
+void machine_state::map_rom(uint32_t address, size_t size)
+{
+    // Note: The ROM image is loaded through copy_to_memory() or copy_file_to_memory(), which bypass the bus. Load it after
+    // load_program(), which clears ROM pages as well.
+    m_bus.map_rom(address, size);
+    commit_memory(&m_memory[address], size);
+    m_decode_cache.invalidate_all();
+}
+
+void machine_state::map_device(uint32_t address, size_t size, bus_device* device)
+{
+    m_bus.map_device(address, size, device);
+    m_decode_cache.invalidate_all();
 }
 
 void machine_state::tick()
 {
     auto opcode = next<uint16_t>();
-    auto inst_func = m_opcode_table[opcode];
-    IF_FALSE_THROW(inst_func != nullptr, "Invalid or unimplemented opcode: 0x" << std::hex << opcode << std::dec << " (" << std::bitset<16>(opcode) << ")");
-    inst_func(*this, opcode);
+    m_opcode_table[opcode](*this, opcode);
 }
 
-void machine_state::set_program_counter(uint32_t value)
+INLINE stop_reason machine_state::run_table(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
 {
-    IF_FALSE_THROW(value < m_memory_size, "Invalid program counter value: " << value);
-    m_registers.PC = value;
+    // Note: The table is kept in a local so the loop does not reload it through 'this' after every handler call
+    const inst_func_ptr_t* table = m_opcode_table;
+
+    while (executed < max_instructions)
+    {
+        auto opcode = next<uint16_t>();
+        table[opcode](*this, opcode);
+        executed++;
+
+        if (m_exit_requested)
+        {
+            return get_stop_reason();
+        }
+
+        if (m_registers.PC == breakpoint)
+        {
+            return stop_reason::breakpoint;
+        }
+    }
+
+    return stop_reason::budget_exhausted;
 }
 
-void machine_state::offset_program_counter(int32_t offset)
+INLINE stop_reason machine_state::run_profiled(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
 {
-    int64_t pc = int64_t(m_registers.PC);
-    pc += int64_t(offset);
-    IF_FALSE_THROW(pc < 0 || pc > int64_t(m_memory_size), "Invalid program counter offset value: " << offset);
-    m_registers.PC = uint32_t(pc);
+    const inst_func_ptr_t* table = m_opcode_table;
+    uint64_t* profile = m_opcode_profile.data();
+
+    while (executed < max_instructions)
+    {
+        auto opcode = next<uint16_t>();
+        profile[opcode]++;
+        table[opcode](*this, opcode);
+        executed++;
+
+        if (m_exit_requested)
+        {
+            return get_stop_reason();
+        }
+
+        if (m_registers.PC == breakpoint)
+        {
+            return stop_reason::breakpoint;
+        }
+    }
+
+    return stop_reason::budget_exhausted;
 }
 
-void machine_state::push_program_counter()
+INLINE stop_reason machine_state::run_compact(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
 {
-    push<uint32_t>(m_registers.PC);
+    const inst_func_ptr_t* handlers = get_handlers();
+    const uint16_t* index_table = get_status_bit<bit::supervisor>() ? get_handler_index_table() : get_user_handler_index_table();
+
+    while (executed < max_instructions)
+    {
+        auto opcode = next<uint16_t>();
+        handlers[index_table[opcode]](*this, opcode);
+        executed++;
+
+        if (m_exit_requested)
+        {
+            return get_stop_reason();
+        }
+
+        if (m_registers.PC == breakpoint)
+        {
+            return stop_reason::breakpoint;
+        }
+    }
+
+    return stop_reason::budget_exhausted;
 }
 
-void machine_state::pop_program_counter()
+INLINE stop_reason machine_state::run_predecoded(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
 {
-    m_registers.PC = pop<uint32_t>();
+    // Note: The records and generation of the current page are kept in locals until the PC leaves the page
+    uint32_t page_base = m_registers.PC & ~decode_cache::page_mask;
+    decoded_instruction* page = m_decode_cache.get_page(page_base);
+    const uint32_t* generation = m_decode_cache.get_generation(page_base);
+
+    // Note: Record of the previous instruction while it is in the current page, a candidate for fusing with the next one
+    decoded_instruction* previous = nullptr;
+
+    while (executed < max_instructions)
+    {
+        auto pc = m_registers.PC;
+        if ((pc & ~decode_cache::page_mask) != page_base)
+        {
+            page_base = pc & ~decode_cache::page_mask;
+            page = m_decode_cache.get_page(page_base);
+            generation = m_decode_cache.get_generation(page_base);
+            previous = nullptr;
+        }
+
+        inst_func_ptr_t handler;
+        uint16_t opcode;
+        uint32_t count;
+
+        auto& inst = page[(pc & decode_cache::page_mask) >> 1];
+        if (inst.generation == *generation && (pc & 0x1) == 0)
+        {
+            handler = inst.handler;
+            opcode = inst.opcode;
+            count = inst.count;
+
+            // Note: A fused pair would step over a breakpoint or past the budget, so it is split again
+            if (count != 1 && (breakpoint != no_breakpoint || max_instructions - executed < count))
+            {
+                handler = get_cached_handler(opcode);
+                count = 1;
+            }
+        }
+        else
+        {
+            opcode = read_memory<uint16_t>(pc);
+            handler = get_cached_handler(opcode);
+            count = 1;
+
+            // Note: Records are kept per word, so an odd PC is executed without going through the cache
+            if ((pc & 0x1) == 0)
+            {
+                inst = { handler, *generation, opcode, 1, 0 };
+                m_decode_cache.mark_code(pc, decode_cache::max_instruction_size);
+                decode_operand(inst, pc);
+                fuse_with_previous(previous, opcode, *generation);
+            }
+        }
+
+        previous = ((pc & 0x1) == 0) ? &inst : nullptr;
+
+        m_decoded = &inst;
+        m_registers.PC += sizeof(uint16_t);
+        handler(*this, opcode);
+        executed += count;
+
+        if (m_exit_requested)
+        {
+            return get_stop_reason();
+        }
+
+        if (m_registers.PC == breakpoint)
+        {
+            return stop_reason::breakpoint;
+        }
+    }
+
+    return stop_reason::budget_exhausted;
 }
 
-void machine_state::push_status_register()
+// Switches a freshly decoded record to a handler that takes its extension words from the record, if it has one.
+// The first run still goes through the generic handler, which reads them from memory.
+void machine_state::decode_operand(decoded_instruction& inst, uint32_t pc)
 {
-    push<uint16_t>(m_registers.SR);
+    // Note: The operand handlers stand in for the generated handlers, so instances with overridden handlers keep those
+    uint32_t operand_size = 0;
+    auto handler = has_opcode_overrides() ? nullptr : get_decoded_operand_handler(inst.opcode, operand_size);
+
+    // Note: Records are only invalidated by writes to their own page, so the extension words must be in it as well
+    auto operand_pc = pc + sizeof(uint16_t);
+    if (handler == nullptr || ((operand_pc + operand_size - 1) & ~decode_cache::page_mask) != (pc & ~decode_cache::page_mask))
+    {
+        return;
+    }
+
+    inst.operand = (operand_size == sizeof(uint32_t)) ? read_memory<uint32_t>(operand_pc) : read_memory<uint16_t>(operand_pc);
+    inst.handler = handler;
 }
 
-void machine_state::pop_status_register()
+// Turns the record of the previous instruction into a fused pair with 'opcode', the instruction just decoded after it.
+// First opcodes of a pair never branch, so the previous instruction is known to fall through to this one.
+void machine_state::fuse_with_previous(decoded_instruction* previous, uint16_t opcode, uint32_t generation)
 {
-    m_registers.SR = pop<uint16_t>();
+    // Note: Fused handlers call the generated handlers directly, so instances with overridden handlers do not fuse
+    if (previous == nullptr || previous->generation != generation || previous->count != 1 || has_opcode_overrides())
+    {
+        return;
+    }
+
+    auto handler = get_fused_handler(previous->opcode, opcode);
+    if (handler != nullptr)
+    {
+        previous->handler = handler;
+        previous->count = 2;
+    }
+}
+
+// Fuses adjacent ops of a freshly recorded block, each fused op is followed by the op it covers
+void machine_state::fuse_block(basic_block& block)
+{
+    if (has_opcode_overrides())
+    {
+        return;
+    }
+
+    for (size_t index = 0; index + 1 < block.ops.size(); index += block.ops[index].count)
+    {
+        auto handler = get_fused_handler(block.ops[index].opcode, block.ops[index + 1].opcode);
+        if (handler != nullptr)
+        {
+            block.ops[index].handler = handler;
+            block.ops[index].count = 2;
+        }
+    }
+}
+
+// Note: Privileged opcodes have a different handler per mode, so cached decodes dispatch them through the current table
+inst_func_ptr_t machine_state::get_cached_handler(uint16_t opcode)
+{
+    return (m_supervisor_table[opcode] == m_user_table[opcode]) ? m_opcode_table[opcode] : &dispatch_current_mode;
+}
+
+void machine_state::dispatch_current_mode(machine_state& state, uint16_t opcode)
+{
+    state.m_opcode_table[opcode](state, opcode);
+}
+
+void machine_state::record_block(basic_block& block, uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
+{
+    const uint32_t page_base = block.start_pc & ~decode_cache::page_mask;
+
+    block.ops.clear();
+    block.generation = *m_decode_cache.get_generation(block.start_pc);
+
+    // Note: The block is executed while it is recorded, one instruction at a time
+    while (true)
+    {
+        auto pc = m_registers.PC;
+        auto opcode = read_memory<uint16_t>(pc);
+        auto handler = get_cached_handler(opcode);
+
+        m_decode_cache.mark_code(pc, decode_cache::max_instruction_size);
+        clear_last_exception();
+        m_registers.PC += sizeof(uint16_t);
+        handler(*this, opcode);
+        executed++;
+        block.ops.push_back({ handler, pc, opcode, 1 });
+
+        // Note: An exception (e.g. division by zero, CHK or TRAPV) continues in its handler instead of the next instruction,
+        // which may be in the same page. Ending the block there keeps its ops contiguous (see basic_block::contains()).
+        if (m_block_end_table[opcode] ||
+            m_last_exception != 0 ||
+            m_exit_requested ||
+            block.ops.size() == block_cache::max_block_length ||
+            (m_registers.PC & ~decode_cache::page_mask) != page_base)
+        {
+            break;
+        }
+
+        if (executed >= max_instructions || m_registers.PC == breakpoint)
+        {
+            // Note: The block was cut short by the caller, so it is not kept
+            block.generation = 0;
+            break;
+        }
+    }
+
+    fuse_block(block);
+}
+
+INLINE stop_reason machine_state::run_blocks(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
+{
+    basic_block* previous = nullptr;
+
+    while (executed < max_instructions)
+    {
+        // Note: Block entry is where pending stops, mode switches (and later, interrupts) are picked up, instead of after every instruction
+        if (m_exit_requested)
+        {
+            return get_stop_reason();
+        }
+
+        auto pc = m_registers.PC;
+        basic_block* block = (previous != nullptr) ? previous->find_successor(pc) : nullptr;
+        if (block == nullptr)
+        {
+            block = &m_block_cache.get(pc);
+            if (previous != nullptr)
+            {
+                previous->link(pc, block);
+            }
+        }
+
+        if (block->generation != *m_decode_cache.get_generation(pc) || (pc & 0x1) != 0)
+        {
+            record_block(*block, max_instructions, breakpoint, executed);
+        }
+        else if (max_instructions - executed < block->ops.size() || block->contains(breakpoint))
+        {
+            // Note: The block does not fit in the remaining budget or has a breakpoint inside it, so finish instruction by instruction
+            return run_table(max_instructions, breakpoint, executed);
+        }
+        else
+        {
+            const block_op* begin = block->ops.data();
+            const block_op* end = begin + block->ops.size();
+            const block_op* op = begin;
+
+            // Note: Leave the block early if an instruction did not fall through to the next one (e.g. it raised an exception) or faulted.
+            // A fused op runs the op after it as well, so that one is skipped.
+            do
+            {
+                m_registers.PC += sizeof(uint16_t);
+                op->handler(*this, op->opcode);
+                op += op->count;
+            } while (op != end && m_registers.PC == op->pc && !m_exit_requested);
+
+            executed += uint64_t(op - begin);
+        }
+
+        if (m_registers.PC == breakpoint)
+        {
+            return stop_reason::breakpoint;
+        }
+
+        previous = block;
+    }
+
+    return m_exit_requested ? get_stop_reason() : stop_reason::budget_exhausted;
+}
+
+INLINE stop_reason machine_state::run_dispatch(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed)
+{
+    // Note: The trace table wraps every handler, only the table loop looks it up per instruction (compact and threaded have
+    // their own tables, cached decodes and blocks bypass it)
+    if (m_opcode_table == m_trace_table)
+    {
+        return run_table(max_instructions, breakpoint, executed);
+    }
+
+    // Note: Profiling counts every opcode in its own loop, so the other loops do not pay for it
+    if (!m_opcode_profile.empty())
+    {
+        return run_profiled(max_instructions, breakpoint, executed);
+    }
+
+    switch (m_dispatch_mode)
+    {
+    case dispatch_mode::compact:
+        // Note: The compact table is shared and generated, so overridden handlers need the table loop
+        if (has_opcode_overrides())
+        {
+            return run_table(max_instructions, breakpoint, executed);
+        }
+        return run_compact(max_instructions, breakpoint, executed);
+#if HAS_COMPUTED_GOTO
+    case dispatch_mode::threaded:
+        // Note: The threaded core jumps through its own generated label table, so overridden handlers need the table loop
+        if (has_opcode_overrides())
+        {
+            return run_table(max_instructions, breakpoint, executed);
+        }
+        return run_threaded(*this, max_instructions, breakpoint, executed);
+#endif
+    case dispatch_mode::predecoded:
+        return run_predecoded(max_instructions, breakpoint, executed);
+    case dispatch_mode::blocks:
+        return run_blocks(max_instructions, breakpoint, executed);
+    default:
+        return run_table(max_instructions, breakpoint, executed);
+    }
+}
+
+bool machine_state::set_dispatch_mode(dispatch_mode mode)
+{
+    // Note: The threaded core needs computed goto, which MSVC does not have
+    if (mode == dispatch_mode::threaded && !HAS_COMPUTED_GOTO)
+    {
+        return false;
+    }
+    m_dispatch_mode = mode;
+    return true;
+}
+
+stop_reason machine_state::run_loop(uint64_t max_instructions, uint32_t breakpoint)
+{
+    uint64_t executed = 0;
+    stop_reason reason;
+
+    if (m_stopped)
+    {
+        return get_stop_reason();
+    }
+
+    try
+    {
+        while (true)
+        {
+            m_exit_requested = false;
+            reason = run_dispatch(max_instructions, breakpoint, executed);
+            if (!m_exit_requested || m_stopped)
+            {
+                break;
+            }
+
+            // Note: The loop was left for a mode switch, so it is entered again with the tables of the new mode
+            if (m_registers.PC == breakpoint)
+            {
+                reason = stop_reason::breakpoint;
+                break;
+            }
+        }
+    }
+    catch (std::exception& ex)
+    {
+        m_last_error = ex.what();
+        raise_fault(fault::internal_error);
+        reason = stop_reason::fault;
+    }
+
+    m_instruction_count += executed;
+    return reason;
+}
+
+stop_reason machine_state::run(uint64_t max_instructions)
+{
+    return run_loop(max_instructions, no_breakpoint);
+}
+
+stop_reason machine_state::run_until(uint32_t pc, uint64_t max_instructions)
+{
+    return run_loop(max_instructions, pc);
 }
 
 void machine_state::exception(uint32_t vector_index)
 {
-    push_program_counter();
-    push_status_register();
-    set_status_bit<bit::supervisor>(true);
+    // Note: Exception processing enters supervisor mode and ends tracing, the handler itself is not traced
+    uint16_t sr = get_status_register();
+    set_status_register((sr | (1 << uint32_t(bit::supervisor))) & ~(1 << uint32_t(bit::trace)));
+    push_exception_frame(sr, m_registers.PC);
+    m_last_exception = vector_index;
 
-    uint32_t* vector_table = (uint32_t*)m_memory;
-    uint32_t vector_offset = read(vector_table + vector_index);
+    uint32_t vector_offset = read_memory<uint32_t>(vector_index * sizeof(uint32_t));
     
     set_program_counter(vector_offset);
 }
@@ -92,16 +674,76 @@ void machine_state::exception(uint32_t vector_index)
 void machine_state::reset()
 {
     // TODO
-    THROW("Reset not implemented");
+    raise_fault(fault::unimplemented_instruction);
 }
 
 void machine_state::stop()
 {
-    // TODO
-    THROW("Stop not implemented");
+    // Note: Execution resumes on interrupt or reset, neither of which is implemented yet, so a stopped machine stays stopped until the next load_program()
+    m_stopped = true;
+    m_exit_requested = true;
+}
+
+void machine_state::raise_fault(fault code)
+{
+    // Note: The first fault is kept, later ones are usually a consequence of it
+    if (m_fault == fault::none)
+    {
+        m_fault = code;
+    }
+    m_stopped = true;
+    m_exit_requested = true;
+}
+
+void machine_state::set_opcode_handler(uint16_t opcode, inst_func_ptr_t handler)
+{
+    // Note: The shared tables are copied the first time an instance overrides a handler, other instances are unaffected
+    if (m_opcode_table_override.empty())
+    {
+        m_opcode_table_override.assign(m_supervisor_table, m_supervisor_table + opcode_table_size);
+        m_opcode_table_override.insert(m_opcode_table_override.end(), m_user_table, m_user_table + opcode_table_size);
+        m_supervisor_table = m_opcode_table_override.data();
+        m_user_table = m_opcode_table_override.data() + opcode_table_size;
+        m_opcode_table = select_opcode_table(m_registers.SR);
+    }
+
+    // Note: An override applies in both modes, nullptr restores the default handlers
+    m_opcode_table_override[opcode] = (handler != nullptr) ? handler : get_opcode_table()[opcode];
+    m_opcode_table_override[opcode_table_size + opcode] = (handler != nullptr) ? handler : get_user_opcode_table()[opcode];
+
+    // Cached decodes and recorded blocks may refer to the previous handler
+    m_decode_cache.invalidate_all();
+}
+
+void machine_state::enable_opcode_profile()
+{
+    m_opcode_profile.assign(opcode_table_size, 0);
+}
+
+void machine_state::write_opcode_profile(const char* path)
+{
+    IF_FALSE_THROW(!m_opcode_profile.empty(), "Opcode profile is not enabled");
+
+    std::vector<uint16_t> opcodes;
+    for (size_t opcode = 0; opcode < m_opcode_profile.size(); opcode++)
+    {
+        if (m_opcode_profile[opcode] != 0)
+        {
+            opcodes.push_back(uint16_t(opcode));
+        }
+    }
+    std::stable_sort(opcodes.begin(), opcodes.end(), [this](uint16_t a, uint16_t b) { return m_opcode_profile[a] > m_opcode_profile[b]; });
+
+    std::ofstream file(path);
+    IF_FALSE_THROW(file.good(), "Unable to write profile: " << path);
+    for (auto opcode : opcodes)
+    {
+        file << "0x" << std::hex << std::setw(4) << std::setfill('0') << opcode << " " << std::dec << m_opcode_profile[opcode] << std::endl;
+    }
 }
 
 void machine_state::set_condition_code_register(uint8_t ccr)
 {
     m_registers.SR = (m_registers.SR & 0xff00) | uint16_t(ccr);
+    m_flags.op = flags_op::none;
 }
@@ -2,9 +2,13 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <utility>
 #include <iostream>
 #include <iomanip>
 #include "common.h"
+#include "decodecache.h"
+#include "blockcache.h"
+#include "bus.h"
 
 enum class bit
 {
@@ -20,180 +24,714 @@ enum class bit
 
 enum class reg
 {
-    status_register,
     user_stack_pointer,
     supervisor_stack_pointer,
 };
 
+enum class stop_reason
+{
+    budget_exhausted,   // The instruction budget given to run() was used up
+    stopped,            // The CPU executed a STOP instruction
+    fault,              // The emulator could not continue (see get_fault())
+    breakpoint,         // The program counter reached the address given to run_until()
+};
+
+//
+// Faults
+// Host side problems are reported as a fault code instead of a C++ exception. The handler that raises a fault runs to
+// completion (a faulting operand reads and writes scratch storage), so its destination may hold garbage. The run loop
+// then returns stop_reason::fault, and the machine stays stopped until the next load_program(). Guest errors such as
+// illegal opcodes are not faults, they raise the corresponding 68000 exception.
+//
+
+enum class fault
+{
+    none,
+    invalid_memory_pointer,         // An instruction needed the address of an operand that is not in memory
+    unimplemented_addressing_mode,  // The effective address uses a mode that is not implemented yet
+    unimplemented_instruction,      // The instruction is decoded but not implemented yet
+    internal_error,                 // The emulator threw an exception (see last_error())
+};
+
+//
+// Memory configuration
+// The guest address space is 2^address_bits bytes, of which the first ram_size bytes are RAM. The rest is unmapped (reads
+// as zero, writes are dropped) until map_ram(), map_rom() or map_device() maps it. The whole address space is reserved,
+// but host memory is only committed for RAM and ROM and only backed as the guest touches it.
+//
+
+struct memory_config
+{
+    uint32_t address_bits = 24;             // 24 for the 68000, up to 32 for 68020-class guests
+    size_t ram_size = size_t(1) << 24;      // A multiple of memory_bus::page_size
+};
+
+enum class dispatch_mode
+{
+    table,      // Fetch and call through the opcode table from a single loop
+    compact,    // Like table, but through a 16-bit handler index per opcode (128 KB instead of 512 KB of table)
+    threaded,   // Generated direct-threaded core, each handler dispatches the next opcode (needs computed goto, so not in MSVC builds)
+    predecoded, // Look up handler, opcode and (for hot forms) extension words in the pre-decoded instruction cache instead of fetching and decoding
+    blocks,     // Execute recorded basic blocks, chained to their successors
+};
+
+//
+// Lazy condition codes
+// Flag producing instructions record the operation, its operands and its result instead of updating N, Z, V, C and X
+// one bit at a time. The condition codes are only computed when something reads them (Bcc, Scc, DBcc, ADDX, the SR and
+// CCR instructions, exceptions) and are written back to SR the first time SR itself is accessed.
+//
+
+enum class flags_op
+{
+    none,   // SR holds the current condition codes
+    logic,  // N and Z from the result, V and C cleared, X unaffected (MOVE, TST, CLR, AND, OR, EOR, NOT, ...)
+    add,    // result = dst + src, X and C are the carry out
+    sub,    // result = dst - src, X and C are the borrow
+    cmp,    // result = dst - src, X unaffected
+};
+
+// Note: Instructions are word aligned, so an odd address never matches the program counter
+const uint32_t no_breakpoint = 0x1;
+
+//
+// Operands
+// The location an effective address resolves to: a register (host endian, accessed in place), a guest memory address
+// (big endian) or an immediate value (decoded from the extension words). get_operand<T>() is inlined into the handlers,
+// so wherever the addressing mode is a constant (register operands of an instruction, or every operand with
+// 'codegen.py --specialize-ea') the location is known at compile time and read() and write() reduce to a single access.
+//
+
+enum class location
+{
+    reg,
+    memory,
+    immediate,
+};
+
+template <typename T>
+struct operand
+{
+    location where;
+    union
+    {
+        T* reg;             // location::reg
+        uint32_t address;   // location::memory (always within memory)
+        T value;            // location::immediate
+    };
+
+    static INLINE operand in_register(T* reg) { operand result; result.where = location::reg; result.reg = reg; return result; }
+    static INLINE operand in_memory(uint32_t address) { operand result; result.where = location::memory; result.address = address; return result; }
+    static INLINE operand immediate(T value) { operand result; result.where = location::immediate; result.value = value; return result; }
+};
+
+// Reinterprets an operand as another size at the same location (e.g. the full 32 bits of a data register)
+template <typename U, typename T>
+INLINE operand<U> operand_cast(const operand<T>& src)
+{
+    switch (src.where)
+    {
+    case location::reg: return operand<U>::in_register((U*)src.reg);
+    case location::memory: return operand<U>::in_memory(src.address);
+    default: return operand<U>::immediate(U(src.value));
+    }
+}
+
 class machine_state;
 typedef void(*inst_func_ptr_t)(machine_state&, uint16_t);
 
-#define CHECK_SUPERVISOR(state) if (!state.get_status_bit<bit::supervisor>()) { state.exception(8 /* Privilege violation */); return; }
-
 class machine_state
 {
 private:
     struct registers_t
     {
         uint32_t D[8];      // Data registers (D0 - D7)
-        uint32_t A[7];      // Address registers (A0 - A6)
+        uint32_t A[8];      // Address registers (A0 - A7), A7 is the stack pointer of the current mode
 
-        uint32_t USP;       // User stack pointer (shadowed by A7 in user mode)
-        uint32_t SSP;       // Supervisor stack pointer (shadowed by A7 in supervisor mode)
+        uint32_t inactive_SP; // Stack pointer of the other mode: USP in supervisor mode, SSP in user mode (see set_status_register())
 
         uint32_t PC;        // Program counter, PC (24-bit, max 16MB of memory)
         uint16_t SR;        // Status register, SR (15-8=system byte, 7-0=user byte aka CCR (4: e[X]tend , 3: [N]egative, 2: [Z]ero, 1: o[V]erflow, 0: [C]arry) - bit 5, 6, 7 are ignored)
     };
 
+    struct lazy_flags_t
+    {
+        flags_op op;
+        uint32_t msb;       // Most significant bit of the operation size (0x80, 0x8000 or 0x80000000)
+        uint32_t src;
+        uint32_t dst;
+        uint32_t result;
+    };
+
+    static const size_t memory_guard_size = 0x10000;        // Inaccessible bytes reserved on each side of guest memory
+    static const uint32_t exception_frame_size = 6;         // SR and PC
+    static const size_t opcode_table_size = 0x10000;        // One handler per 16-bit opcode
+
     registers_t m_registers;
-    uint8_t* m_memory;
-    size_t m_memory_size;
-    std::vector<inst_func_ptr_t> m_opcode_table;
-    uint32_t m_storage[4];
-    uint32_t m_storage_index;
+    lazy_flags_t m_flags;
+    uint8_t* m_reservation;
+    size_t m_reservation_size;
+    uint8_t* m_memory;                                      // Guest memory, between two guard regions (see memory_guard_size)
+    size_t m_memory_size;                                   // Size of the guest address space
+    uint32_t m_address_mask;
+    memory_bus m_bus;
+    const inst_func_ptr_t* m_opcode_table;                  // Table of the current mode, m_supervisor_table or m_user_table
+    const inst_func_ptr_t* m_supervisor_table;              // The shared opcode tables, or their halves of m_opcode_table_override
+    const inst_func_ptr_t* m_user_table;
+    const inst_func_ptr_t* m_trace_table;                   // Used while SR.T is set, every entry raises a trace exception after the instruction
+    std::vector<inst_func_ptr_t> m_opcode_table_override;   // Per instance copy of both tables, only allocated by set_opcode_handler()
+    const bool* m_block_end_table;
+    decode_cache m_decode_cache;
+    const decoded_instruction* m_decoded;                   // Record run_predecoded() is running, read by next_decoded()
+    block_cache m_block_cache;
+    uint64_t m_instruction_count;
+    bool m_stopped;         // Set by STOP and by faults
+    bool m_exit_requested;  // Set by STOP, faults and mode switches, the run loops test this single flag after each instruction
+    fault m_fault;
+    uint32_t m_last_exception;  // Vector of the latest exception, cleared by trace() and record_block() before the instruction they watch
+    dispatch_mode m_dispatch_mode;
+    std::string m_last_error;
+    bool m_large_pages;
+    std::vector<uint64_t> m_opcode_profile;                 // Executions per opcode, only allocated by enable_opcode_profile()
+
+    stop_reason run_loop(uint64_t max_instructions, uint32_t breakpoint);
+    stop_reason run_dispatch(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    stop_reason run_table(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    stop_reason run_profiled(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    stop_reason run_compact(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    stop_reason run_predecoded(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    stop_reason run_blocks(uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    void reset_cpu(uint32_t init_pc);
+    size_t get_memory_extent(size_t address);
+    void discard_memory_range(size_t address, size_t size);
+    void record_block(basic_block& block, uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+    inst_func_ptr_t get_cached_handler(uint16_t opcode);
+    void fuse_with_previous(decoded_instruction* previous, uint16_t opcode, uint32_t generation);
+    void decode_operand(decoded_instruction& inst, uint32_t pc);
+    void fuse_block(basic_block& block);
+    static void dispatch_current_mode(machine_state& state, uint16_t opcode);
+
+    INLINE const inst_func_ptr_t* select_opcode_table(uint16_t sr) const
+    {
+        if ((sr & (1 << uint32_t(bit::trace))) != 0)
+        {
+            return m_trace_table;
+        }
+        return ((sr & (1 << uint32_t(bit::supervisor))) != 0) ? m_supervisor_table : m_user_table;
+    }
 
     INLINE uint32_t* get_address_register_pointer(uint32_t reg)
     {
-        // Note: Adress register 7 is special: It refers to the user *or* supervisor stack pointer, depending on the current CPU mode
-        if (reg == 7)
+        // Note: A7 always holds the stack pointer of the current mode, the other one is swapped in when SR.S changes
+        return &m_registers.A[reg];
+    }
+
+    // True if 'size' bytes at 'offset' within a page can be loaded from or stored to host memory directly
+    static INLINE bool is_direct_access(uint32_t offset, uint32_t size)
+    {
+#if NATIVE_ENDIAN_MEMORY
+        // Note: Odd word and long accesses straddle the stored words
+        return size == 1 || ((offset & 0x1) == 0 && offset <= memory_bus::page_size - size);
+#else
+        return size == 1 || offset <= memory_bus::page_size - size;
+#endif
+    }
+
+    template <typename T>
+    static INLINE bool is_direct_access(uint32_t offset)
+    {
+        return is_direct_access(offset, sizeof(T));
+    }
+
+    // Loads and stores a guest value in host memory, in the configured layout (see NATIVE_ENDIAN_MEMORY)
+    template <typename T>
+    static INLINE T load(const uint8_t* page, uint32_t offset)
+    {
+#if NATIVE_ENDIAN_MEMORY
+        switch (sizeof(T))
         {
-            return (uint32_t*)(get_status_bit<bit::supervisor>() ? &m_registers.SSP : &m_registers.USP);
+        case 1: return T(page[offset ^ 1]);
+        case 2: return T(*(const uint16_t*)&page[offset]);
+        default: return T(rotate_left<uint32_t>(*(const uint32_t*)&page[offset], 16));
         }
-        else
+#else
+        return swap<T>(*(const T*)&page[offset]);
+#endif
+    }
+
+    template <typename T>
+    static INLINE void store(uint8_t* page, uint32_t offset, T value)
+    {
+#if NATIVE_ENDIAN_MEMORY
+        switch (sizeof(T))
         {
-            return (uint32_t*)&m_registers.A[reg];
+        case 1: page[offset ^ 1] = uint8_t(value); break;
+        case 2: *(uint16_t*)&page[offset] = uint16_t(value); break;
+        default: *(uint32_t*)&page[offset] = rotate_left<uint32_t>(uint32_t(value), 16); break;
         }
+#else
+        *(T*)&page[offset] = swap<T>(value);
+#endif
     }
 
+    // Device pages, unmapped pages, ROM writes and accesses that straddle pages (or stored words)
     template <typename T>
-    INLINE T* get_next_storage_pointer()
+    T read_memory_slow(uint32_t address)
     {
-        T* ptr = (T*)&m_storage[m_storage_index % countof(m_storage)];
-        m_storage_index++;
-        return ptr;
+        bus_device* device = m_bus.get_device(address);
+        if (device != nullptr)
+        {
+            return T(device->read(address, sizeof(T)));
+        }
+
+        // Note: A byte gets here only from an unmapped page, which reads as zero
+        if (sizeof(T) == 1)
+        {
+            return T(0);
+        }
+
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < sizeof(T); i++)
+        {
+            value = (value << 8) | read_memory<uint8_t>(mask_address(address + i));
+        }
+        return T(value);
     }
 
     template <typename T>
-    INLINE bool is_memory(T* ptr)
+    void write_memory_slow(uint32_t address, T value)
     {
-        return ((uint8_t*)ptr >= m_memory && (uint8_t*)ptr < (m_memory + m_memory_size));
+        bus_device* device = m_bus.get_device(address);
+        if (device != nullptr)
+        {
+            device->write(address, sizeof(T), uint32_t(value));
+        }
+        else if (sizeof(T) > 1)
+        {
+            // Note: Bytes that land in ROM or unmapped pages are dropped one by one
+            for (uint32_t i = 0; i < sizeof(T); i++)
+            {
+                write_memory<uint8_t>(mask_address(address + i), uint8_t(uint32_t(value) >> ((sizeof(T) - 1 - i) * 8)));
+            }
+        }
+    }
+
+    // Raises a fault and returns an immediate zero (writes to it are dropped), so the faulting handler can finish
+    template <typename T>
+    INLINE operand<T> get_fault_operand(fault code)
+    {
+        raise_fault(code);
+        return operand<T>::immediate(T(0));
     }
  
 public:
-    machine_state();
+    machine_state(const memory_config& config = memory_config());
     virtual ~machine_state();
+    // Note: Loading a program clears all RAM and ROM first (see clear_memory()), so ROM images are copied in after it
     void load_program(size_t memory_offset, void* program, size_t program_size, uint32_t init_pc);
+    void load_program_file(size_t memory_offset, const char* path, uint32_t init_pc, bool map); // 'map': see map_file_to_memory()
+    void clear_memory(); // Zeros RAM and ROM pages alike
+    bool enable_large_pages(); // Backs guest memory with large pages where the host supports it, returns false otherwise
+    // Note: The loaders below write memory behind the back of the bus and drop all pre-decoded instructions and blocks
+    void copy_to_memory(size_t memory_offset, const void* src, size_t size);
+    void copy_file_to_memory(size_t memory_offset, const char* path);
+    void map_file_to_memory(size_t memory_offset, const char* path); // Shares the file's pages (see map_file()), it must not change while loaded
+    void map_ram(uint32_t address, size_t size);
+    void map_rom(uint32_t address, size_t size);
+    void map_device(uint32_t address, size_t size, bus_device* device);
     void tick();
-    void set_program_counter(uint32_t value);
-    void offset_program_counter(int32_t offset);
-    void push_program_counter();
-    void pop_program_counter();
-    void push_status_register();
-    void pop_status_register();
+    stop_reason run(uint64_t max_instructions);
+    stop_reason run_until(uint32_t pc, uint64_t max_instructions);
+    uint64_t instruction_count() const { return m_instruction_count; }
+    bool set_dispatch_mode(dispatch_mode mode); // Returns false (keeping the current mode) if the mode is not compiled into this build
+    dispatch_mode get_dispatch_mode() const { return m_dispatch_mode; }
+    uint32_t get_program_counter() const { return m_registers.PC; }
+    bool is_stopped() const { return m_stopped; }
+    bool is_exit_requested() const { return m_exit_requested; }
+    fault get_fault() const { return m_fault; }
+    stop_reason get_stop_reason() const { return (m_fault != fault::none) ? stop_reason::fault : stop_reason::stopped; }
+    const std::string& last_error() const { return m_last_error; }
     void exception(uint32_t vector);
+    uint32_t get_last_exception() const { return m_last_exception; }
+    void clear_last_exception() { m_last_exception = 0; }
     void reset();
     void stop();
+    void raise_fault(fault code);
     void set_condition_code_register(uint8_t ccr);
+    void set_opcode_handler(uint16_t opcode, inst_func_ptr_t handler);
+    bool has_opcode_overrides() const { return !m_opcode_table_override.empty(); }
+    void enable_opcode_profile(); // Counts the executions of each opcode, runs then use the table loop
+    void write_opcode_profile(const char* path); // One "opcode count" line per executed opcode, hottest first (see codegen.py --profile)
+
+    INLINE void set_program_counter(uint32_t value)
+    {
+        m_registers.PC = mask_address(value);
+    }
+
+    INLINE void offset_program_counter(int32_t offset)
+    {
+        m_registers.PC = mask_address(m_registers.PC + uint32_t(offset));
+    }
+
+    //
+    // Stack
+    // Pushes and pops resolve the active stack pointer once and go through the direct memory path, so the common case (a
+    // stack in RAM) is a single host load or store. Exception frames (SR, then PC) are pushed and popped as a whole, with
+    // one bus lookup unless the frame straddles a page. Everything here is inline, calls and returns are hot.
+    //
 
     template <typename T>
     INLINE void push(T value)
     {
-        uint32_t* stack_ptr = get_pointer<uint32_t>(make_effective_address<1, 7>());
-        uint32_t stack_value = read(stack_ptr);
-        int64_t new_stack_value = int64_t(stack_value) - int64_t(sizeof(T));
-        IF_FALSE_THROW(new_stack_value >= 0, "Stack overflow");
-        write<uint32_t>(stack_ptr, uint32_t(new_stack_value));
-        write<T>((T*)&m_memory[new_stack_value], value);
+        uint32_t* stack_ptr = get_address_register_pointer(7);
+        uint32_t stack_value = *stack_ptr - sizeof(T);
+        *stack_ptr = stack_value;
+        write_memory<T>(mask_address(stack_value), value);
     }
 
     template <typename T>
     INLINE T pop()
     {
-        uint32_t* stack_ptr = get_pointer<uint32_t>(make_effective_address<1, 7>());
-        uint32_t stack_value = read(stack_ptr);
-        T* mem_ptr = (T*)&m_memory[stack_value];
-        T result = read(mem_ptr);
-        uint32_t new_stack_value = stack_value + sizeof(T);
-        write<uint32_t>(stack_ptr, new_stack_value);
-        return result;
+        uint32_t* stack_ptr = get_address_register_pointer(7);
+        uint32_t stack_value = *stack_ptr;
+        *stack_ptr = stack_value + sizeof(T);
+        return read_memory<T>(mask_address(stack_value));
+    }
+
+    INLINE void push_program_counter()
+    {
+        push<uint32_t>(m_registers.PC);
     }
 
+    INLINE void pop_program_counter()
+    {
+        set_program_counter(pop<uint32_t>());
+    }
+
+    // Note: Exception processing enters supervisor mode first, so the frame goes on the supervisor stack
+    INLINE void push_exception_frame(uint16_t sr, uint32_t pc)
+    {
+        m_registers.A[7] -= exception_frame_size;
+        uint32_t address = mask_address(m_registers.A[7]);
+        uint8_t* page = m_bus.get_write_page(address);
+        uint32_t offset = address & memory_bus::page_mask;
+        if (page != nullptr && is_direct_access(offset, exception_frame_size))
+        {
+            m_decode_cache.invalidate(address, exception_frame_size);
+            store<uint16_t>(page, offset, sr);
+            store<uint32_t>(page, offset + sizeof(uint16_t), pc);
+        }
+        else
+        {
+            write_memory<uint16_t>(address, sr);
+            write_memory<uint32_t>(mask_address(address + sizeof(uint16_t)), pc);
+        }
+    }
+
+    // Note: Both words come off the current stack before the restored SR can switch stacks
+    INLINE void pop_exception_frame()
+    {
+        uint32_t* stack_ptr = get_address_register_pointer(7);
+        uint32_t address = mask_address(*stack_ptr);
+        *stack_ptr += exception_frame_size;
+
+        uint16_t sr;
+        uint32_t pc;
+        uint8_t* page = m_bus.get_read_page(address);
+        uint32_t offset = address & memory_bus::page_mask;
+        if (page != nullptr && is_direct_access(offset, exception_frame_size))
+        {
+            sr = load<uint16_t>(page, offset);
+            pc = load<uint32_t>(page, offset + sizeof(uint16_t));
+        }
+        else
+        {
+            sr = read_memory<uint16_t>(address);
+            pc = read_memory<uint32_t>(mask_address(address + sizeof(uint16_t)));
+        }
+
+        set_status_register(sr);
+        set_program_counter(pc);
+    }
+
+    // Wraps an address around the end of memory (the 68000 has a 24-bit address bus)
+    INLINE uint32_t mask_address(uint32_t address) const
+    {
+        return address & m_address_mask;
+    }
+
+    // Note: 'address' must be within memory (see mask_address())
     template <typename T>
-    INLINE uint32_t pointer_to_memory_offset(T* ptr)
+    INLINE T read_memory(uint32_t address)
     {
-        IF_FALSE_THROW(is_memory(ptr), "Invalid memory pointer");
-        return uint32_t(size_t(ptr) - size_t(m_memory));
+        uint8_t* page = m_bus.get_read_page(address);
+        uint32_t offset = address & memory_bus::page_mask;
+        if (page != nullptr && is_direct_access<T>(offset))
+        {
+            return load<T>(page, offset);
+        }
+        return read_memory_slow<T>(address);
     }
 
     template <typename T>
-    INLINE void write(T* dst, T value)
+    INLINE void write_memory(uint32_t address, T value)
     {
-        if (is_memory(dst))
+        uint8_t* page = m_bus.get_write_page(address);
+        uint32_t offset = address & memory_bus::page_mask;
+        if (page != nullptr && is_direct_access<T>(offset))
         {
-            *dst = swap<T>(value);
+            m_decode_cache.invalidate(address, sizeof(T));
+            store<T>(page, offset, value);
+            return;
         }
-        else
+        write_memory_slow<T>(address, value);
+    }
+
+    template <typename T>
+    INLINE T read(const operand<T>& src)
+    {
+        switch (src.where)
         {
-            *dst = value;
+        case location::reg: return *src.reg;
+        case location::memory: return read_memory<T>(src.address);
+        default: return src.value;
         }
     }
 
     template <typename T>
-    INLINE T read(T* src)
+    INLINE void write(const operand<T>& dst, T value)
     {
-        if (is_memory(src))
+        switch (dst.where)
         {
-            return swap(*src);
+        case location::reg: *dst.reg = value; break;
+        case location::memory: write_memory<T>(dst.address, value); break;
+        default: break; // Note: Immediates are never a destination in the opcode table, this only drops writes to a fault operand
         }
-        else
+    }
+
+    // Returns the address of a memory operand (LEA, PEA, JMP, JSR)
+    template <typename T>
+    INLINE uint32_t get_address(const operand<T>& src)
+    {
+        if (src.where != location::memory)
         {
-            return *src;
+            raise_fault(fault::invalid_memory_pointer);
+            return 0;
         }
+        return src.address;
+    }
+
+    // Registers returned by get_pointer(reg)
+    template <typename T>
+    INLINE void write(T* dst, T value)
+    {
+        *dst = value;
+    }
+
+    template <typename T>
+    INLINE T read(T* src)
+    {
+        return *src;
     }
 
     template <typename T>
     INLINE T next()
     {
-        T* ptr = (T*)&m_memory[m_registers.PC];
+        T value = read_memory<T>(m_registers.PC);
+        m_registers.PC += sizeof(T);
+        return value;
+    }
+
+    // Same as next(), but takes the extension words from the pre-decoded record (see get_decoded_operand_handler())
+    template <typename T>
+    INLINE T next_decoded()
+    {
         m_registers.PC += sizeof(T);
-        return swap<T>(*ptr);
+        return T(m_decoded->operand);
+    }
+
+    // Returns the CCR with any pending lazy condition codes applied, without writing them back to SR
+    INLINE uint8_t get_condition_code_register()
+    {
+        uint8_t ccr = uint8_t(m_registers.SR & 0xff);
+        if (m_flags.op == flags_op::none)
+        {
+            return ccr;
+        }
+
+        auto msb = m_flags.msb;
+        auto src = m_flags.src;
+        auto dst = m_flags.dst;
+        auto result = m_flags.result;
+
+        bool x = (ccr & (1 << uint32_t(bit::extend))) != 0;
+        bool n = (result & msb) != 0;
+        bool z = (result == 0);
+        bool v = false;
+        bool c = false;
+
+        switch (m_flags.op)
+        {
+        case flags_op::add:
+            c = result < dst;
+            v = ((src ^ result) & (dst ^ result) & msb) != 0;
+            x = c;
+            break;
+        case flags_op::sub:
+            c = src > dst;
+            v = ((src ^ dst) & (dst ^ result) & msb) != 0;
+            x = c;
+            break;
+        case flags_op::cmp:
+            c = src > dst;
+            v = ((src ^ dst) & (dst ^ result) & msb) != 0;
+            break;
+        default:
+            break;
+        }
+
+        return uint8_t((ccr & 0xe0) |
+            (x ? (1 << uint32_t(bit::extend)) : 0) |
+            (n ? (1 << uint32_t(bit::negative)) : 0) |
+            (z ? (1 << uint32_t(bit::zero)) : 0) |
+            (v ? (1 << uint32_t(bit::overflow)) : 0) |
+            (c ? (1 << uint32_t(bit::carry)) : 0));
+    }
+
+    // Writes pending lazy condition codes back to SR
+    INLINE void flush_flags()
+    {
+        if (m_flags.op != flags_op::none)
+        {
+            m_registers.SR = (m_registers.SR & 0xff00) | uint16_t(get_condition_code_register());
+            m_flags.op = flags_op::none;
+        }
+    }
+
+    // Logic and compare records leave X alone, so before one replaces a pending ADD or SUB record, the X of that record goes to SR
+    INLINE void keep_extend_flag()
+    {
+        if (m_flags.op == flags_op::add || m_flags.op == flags_op::sub)
+        {
+            bool x = (m_flags.op == flags_op::add) ? (m_flags.result < m_flags.dst) : (m_flags.src > m_flags.dst);
+            m_registers.SR = (m_registers.SR & ~(1 << uint32_t(bit::extend))) | uint16_t(uint32_t(x) << uint32_t(bit::extend));
+        }
+    }
+
+    // Records the condition codes of an operation without evaluating them (operands and result are truncated to T)
+    template <const flags_op op, typename T>
+    INLINE void set_flags(T src, T dst, T result)
+    {
+        if (op == flags_op::cmp)
+        {
+            keep_extend_flag();
+        }
+        m_flags.op = op;
+        m_flags.msb = uint32_t(1) << (sizeof(T) * 8 - 1);
+        m_flags.src = uint32_t(src);
+        m_flags.dst = uint32_t(dst);
+        m_flags.result = uint32_t(result);
+    }
+
+    // Writes X, N, Z, V and C with a single store, replacing any pending lazy condition codes
+    INLINE void set_arithmetic_flags(bool x, bool n, bool z, bool v, bool c)
+    {
+        m_registers.SR = (m_registers.SR & 0xffe0) | uint16_t(
+            (uint32_t(x) << uint32_t(bit::extend)) |
+            (uint32_t(n) << uint32_t(bit::negative)) |
+            (uint32_t(z) << uint32_t(bit::zero)) |
+            (uint32_t(v) << uint32_t(bit::overflow)) |
+            (uint32_t(c) << uint32_t(bit::carry)));
+        m_flags.op = flags_op::none;
+    }
+
+    // N and Z from 'result', V and C cleared
+    template <typename T>
+    INLINE void set_logic_flags(T result)
+    {
+        keep_extend_flag();
+        m_flags.op = flags_op::logic;
+        m_flags.msb = uint32_t(1) << (sizeof(T) * 8 - 1);
+        m_flags.result = uint32_t(result);
     }
 
     template <const bit bit>
     INLINE bool get_status_bit()
     {
+        if (uint32_t(bit) <= uint32_t(bit::extend))
+        {
+            flush_flags();
+        }
         return ((m_registers.SR >> uint32_t(bit)) & 0x1) != 0;
     }
 
     template <const bit bit>
     INLINE void set_status_bit(bool value)
     {
+        if (uint32_t(bit) <= uint32_t(bit::extend) || bit == bit::supervisor || bit == bit::trace)
+        {
+            flush_flags(); // Note: Keeps the bits not written here, and the pending condition codes in the SR written below
+        }
         uint16_t mask = 1 << uint32_t(bit);
-        if (value)
+        uint16_t sr = value ? (m_registers.SR | mask) : (m_registers.SR & ~mask);
+        if (bit == bit::supervisor || bit == bit::trace)
         {
-            m_registers.SR |= mask;
+            set_status_register(sr);
         }
         else
         {
-            m_registers.SR &= (~mask);
+            m_registers.SR = sr;
+        }
+    }
+
+    INLINE uint16_t get_status_register()
+    {
+        flush_flags();
+        return m_registers.SR;
+    }
+
+    // Every write of the whole SR goes through here. A change of the supervisor bit swaps the stack pointers, so A7 is the
+    // stack pointer of the new mode. A change of the supervisor or trace bit switches to the opcode table of the new mode.
+    INLINE void set_status_register(uint16_t value)
+    {
+        uint16_t changed = m_registers.SR ^ value;
+        m_registers.SR = value;
+        m_flags.op = flags_op::none;
+        if ((changed & ((1 << uint32_t(bit::supervisor)) | (1 << uint32_t(bit::trace)))) != 0)
+        {
+            if ((changed & (1 << uint32_t(bit::supervisor))) != 0)
+            {
+                std::swap(m_registers.A[7], m_registers.inactive_SP);
+            }
+
+            // Note: The run loops keep the table in locals, so they are left and re-entered with the table of the new mode
+            m_opcode_table = select_opcode_table(value);
+            m_exit_requested = true;
         }
     }
 
+    // Runs the handler of the current mode, the trace table calls this for each traced instruction (see trace())
+    INLINE void execute_untraced(uint16_t opcode)
+    {
+        const inst_func_ptr_t* table = get_status_bit<bit::supervisor>() ? m_supervisor_table : m_user_table;
+        table[opcode](*this, opcode);
+    }
+
     template <typename T>
     INLINE T* get_pointer(reg reg)
     {
+        bool supervisor = get_status_bit<bit::supervisor>();
         switch (reg)
         {
-        case reg::status_register: return (T*)&m_registers.SR;
-        case reg::supervisor_stack_pointer: return (T*)&m_registers.SSP;
-        case reg::user_stack_pointer: return (T*)&m_registers.USP;
+        case reg::supervisor_stack_pointer: return (T*)(supervisor ? &m_registers.A[7] : &m_registers.inactive_SP);
+        case reg::user_stack_pointer: return (T*)(supervisor ? &m_registers.inactive_SP : &m_registers.A[7]);
         default:
             THROW("Invalid register");
         }
     }
 
     template <typename T>
-    INLINE T* get_pointer(uint32_t effective_address)
+    INLINE operand<T> get_operand(uint32_t effective_address)
     {
         auto reg = effective_address & 0x7;
         auto mode = (effective_address >> 3) & 0x7;
@@ -202,19 +740,19 @@ public:
         {
         case 0: // Data register direct
         {
-            return (T*)&m_registers.D[reg];
+            return operand<T>::in_register((T*)&m_registers.D[reg]);
         }
 
         case 1: // Address register direct
         {
-            return (T*)get_address_register_pointer(reg);
+            return operand<T>::in_register((T*)get_address_register_pointer(reg));
         }
             
         case 2: // Address register indirect
         {
             auto ptr = get_address_register_pointer(reg);
             auto value = *ptr;
-            return (T*)&m_memory[value];
+            return operand<T>::in_memory(mask_address(value));
         }
 
         case 3: // Address register indirect with postincrement
@@ -222,7 +760,7 @@ public:
             auto ptr = get_address_register_pointer(reg);
             auto value = *ptr;
             (*ptr) += sizeof(T);
-            return (T*)&m_memory[value];
+            return operand<T>::in_memory(mask_address(value));
         }
 
         case 4: // Address register indirect with predecrement
@@ -230,58 +768,53 @@ public:
             auto ptr = get_address_register_pointer(reg);
             (*ptr) -= sizeof(T);
             auto value = *ptr;
-            return (T*)&m_memory[value];
+            return operand<T>::in_memory(mask_address(value));
         }
          
         case 5: // Address register indirect with displacement
         {
             auto ptr = get_address_register_pointer(reg);
             auto value = *ptr;
-            auto displacement = next<uint16_t>();
-            return (T*)&m_memory[value + displacement];
+            auto displacement = sign_extend(next<uint16_t>());
+            return operand<T>::in_memory(mask_address(value + displacement));
         }
 
         case 6: // Address register indirect with index
-            THROW("Unimplemented addressing mode: " << mode);
+            return get_fault_operand<T>(fault::unimplemented_addressing_mode);
 
         case 7:
             switch (reg)
             {
             case 0: // Absolute short
             {
-                uint16_t* ptr = get_next_storage_pointer<uint16_t>();
-                *ptr = next<uint16_t>();
-                return (T*)ptr;
+                auto address = sign_extend(next<uint16_t>());
+                return operand<T>::in_memory(mask_address(address));
             }
                 
             case 1: // Absolute long
             {
-                uint32_t* ptr = get_next_storage_pointer<uint32_t>();
-                *ptr = next<uint32_t>();
-                return (T*)ptr;
+                auto address = next<uint32_t>();
+                return operand<T>::in_memory(mask_address(address));
             }
 
             case 2: // Program counter with displacement
-                THROW("Unimplemented addressing mode: " << mode);
+                return get_fault_operand<T>(fault::unimplemented_addressing_mode);
 
             case 3: // Program counter with index
-                THROW("Unimplemented addressing mode: " << mode);
+                return get_fault_operand<T>(fault::unimplemented_addressing_mode);
 
             case 4: // Immediate or status register
             {
                 typedef traits<T>::extension_word_type_t extension_t;
-                extension_t* ptr = get_next_storage_pointer<extension_t>();
-                *ptr = next<extension_t>();
-                return (T*)ptr;
+                return operand<T>::immediate(T(next<extension_t>()));
             }
 
-            default:
-                THROW("Invalid register value for adressing mode 7: " << reg);
+            default: // Note: Not reachable through the opcode table, which only holds valid modes
+                return get_fault_operand<T>(fault::unimplemented_addressing_mode);
             }
-            break;
 
         default:
-            THROW("Invalid addressing mode: " << mode);
+            return get_fault_operand<T>(fault::unimplemented_addressing_mode);
         }
     }
 };
\ No newline at end of file
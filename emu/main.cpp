@@ -2,6 +2,7 @@
 #include <vector>
 #include <stack>
 #include <bitset>
+#include <chrono>
 #include <intrin.h>
 
 #include "common.h"
@@ -74,29 +75,97 @@ http://raregame.ru/file/15/NEO-GEO_Startup.asm
 
 
 
-int main(void)
+int main(int argc, char** argv)
 {
     try
     {
-        machine_state machine;
-
-        FILE* fp = nullptr;
-        ::fopen_s(&fp, "C:\\Users\\dideriks\\Desktop\\EASy68K\\EASy68K\\test.bin", "rb");
-        if (fp)
+        memory_config config;
+        dispatch_mode dispatch = dispatch_mode::table;
+        bool large_pages = false;
+        bool map_program = false;
+        const char* profile_path = nullptr;
+        const char* path = "C:\\Users\\dideriks\\Desktop\\EASy68K\\EASy68K\\test.bin";
+
+        // Usage: emu [program] [--dispatch table|compact|threaded|predecoded|blocks] [--large-pages] [--address-bits n] [--ram-size bytes]
+        //            [--profile file] [--map-program]
+        // --map-program maps the program file copy-on-write instead of reading it. The file must not change or shrink while
+        // the program runs, and the pages it covers are not backed by large pages.
+        for (int i = 1; i < argc; i++)
         {
-            ::fseek(fp, 0, SEEK_END);
-            size_t size = ::ftell(fp);
-            ::fseek(fp, 0, SEEK_SET);
-            void* buffer = ::malloc(size);
-            ::fread(buffer, size, 1, fp);
-            ::fclose(fp);
-            machine.load_program(0x1000, buffer, size, 0x1000);
-            ::free(buffer);
-
-            while (true)
+            std::string arg = argv[i];
+            if (arg == "--dispatch" && i + 1 < argc)
+            {
+                std::string mode = argv[++i];
+                if (mode == "table") dispatch = dispatch_mode::table;
+                else if (mode == "compact") dispatch = dispatch_mode::compact;
+                else if (mode == "threaded") dispatch = dispatch_mode::threaded;
+                else if (mode == "predecoded") dispatch = dispatch_mode::predecoded;
+                else if (mode == "blocks") dispatch = dispatch_mode::blocks;
+                else THROW("Unknown dispatch mode: " << mode);
+            }
+            else if (arg == "--large-pages")
+            {
+                large_pages = true;
+            }
+            else if (arg == "--map-program")
+            {
+                map_program = true;
+            }
+            else if (arg == "--address-bits" && i + 1 < argc)
             {
-                machine.tick();
+                config.address_bits = uint32_t(std::stoul(argv[++i]));
             }
+            else if (arg == "--ram-size" && i + 1 < argc)
+            {
+                config.ram_size = size_t(std::stoull(argv[++i], nullptr, 0));
+            }
+            else if (arg == "--profile" && i + 1 < argc)
+            {
+                profile_path = argv[++i];
+            }
+            else
+            {
+                path = argv[i];
+            }
+        }
+
+        machine_state machine(config);
+        if (!machine.set_dispatch_mode(dispatch))
+        {
+            std::cout << "Dispatch mode is not available in this build, using table dispatch" << std::endl;
+        }
+        if (large_pages && !machine.enable_large_pages())
+        {
+            std::cout << "Large pages are not available, using regular pages" << std::endl;
+        }
+        if (profile_path != nullptr)
+        {
+            machine.enable_opcode_profile();
+        }
+
+        machine.load_program_file(0x1000, path, 0x1000, map_program);
+
+        auto start = std::chrono::steady_clock::now();
+        stop_reason reason;
+        do
+        {
+            reason = machine.run(1000000);
+        } while (reason == stop_reason::budget_exhausted);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        switch (reason)
+        {
+        case stop_reason::stopped: std::cout << "Stopped"; break;
+        case stop_reason::fault: std::cout << "Fault " << int(machine.get_fault()) << " " << machine.last_error(); break;
+        default: break;
+        }
+        std::cout << " after " << machine.instruction_count() << " instructions";
+        std::cout << " (" << (double(machine.instruction_count()) / elapsed.count() / 1e6) << " MIPS)" << std::endl;
+
+        // Note: Feed the profile to 'codegen.py --profile' to specialize the hottest opcodes
+        if (profile_path != nullptr)
+        {
+            machine.write_opcode_profile(profile_path);
         }
     }
     catch (std::exception& ex)
@@ -3,4 +3,18 @@
 #include <cstdint>
 #include "machinestate.h"
 
-void make_opcode_table(std::vector<inst_func_ptr_t>& table);
+// Process-wide read-only tables (generated by codegen.py), 0x10000 entries each
+const inst_func_ptr_t* get_opcode_table();         // Supervisor mode
+const inst_func_ptr_t* get_user_opcode_table();    // User mode, privileged opcodes raise a privilege violation
+const inst_func_ptr_t* get_trace_opcode_table();   // Trace mode (SR.T set), every opcode runs trace()
+const inst_func_ptr_t* get_handlers();
+const uint16_t* get_handler_index_table();
+const uint16_t* get_user_handler_index_table();
+const bool* get_block_end_table();
+inst_func_ptr_t get_fused_handler(uint16_t first, uint16_t second); // Handler running both opcodes, or nullptr if the pair is not fused
+inst_func_ptr_t get_decoded_operand_handler(uint16_t opcode, uint32_t& operand_size); // Handler taking its extension words from the pre-decoded record, or nullptr
+const char* get_mnemonic(uint16_t opcode);
+
+#if HAS_COMPUTED_GOTO
+stop_reason run_threaded(machine_state& state, uint64_t max_instructions, uint32_t breakpoint, uint64_t& executed);
+#endif
@@ -0,0 +1,134 @@
+#include <fstream>
+#include "platform.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+void* reserve_memory(size_t size)
+{
+#ifdef _WIN32
+    void* address = ::VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    IF_FALSE_THROW(address != nullptr, "Failed to reserve 0x" << std::hex << size << " bytes");
+#else
+    void* address = ::mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    IF_FALSE_THROW(address != MAP_FAILED, "Failed to reserve 0x" << std::hex << size << " bytes");
+#endif
+    return address;
+}
+
+void commit_memory(void* address, size_t size)
+{
+#ifdef _WIN32
+    IF_FALSE_THROW(::VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != nullptr, "Failed to commit 0x" << std::hex << size << " bytes");
+#else
+    IF_FALSE_THROW(::mprotect(address, size, PROT_READ | PROT_WRITE) == 0, "Failed to commit 0x" << std::hex << size << " bytes");
+#endif
+}
+
+void discard_memory(void* address, size_t size)
+{
+#ifdef _WIN32
+    // Note: MEM_RESET keeps the old contents around until the pages are reused, decommitting guarantees zeros
+    IF_FALSE_THROW(::VirtualFree(address, size, MEM_DECOMMIT) != 0, "Failed to decommit 0x" << std::hex << size << " bytes");
+    commit_memory(address, size);
+#else
+    // Note: A fresh anonymous mapping rather than madvise(MADV_DONTNEED), which would bring back the contents of a file
+    // mapped by map_file() instead of zeros
+    void* mapped = ::mmap(address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    IF_FALSE_THROW(mapped == address, "Failed to discard 0x" << std::hex << size << " bytes");
+#endif
+}
+
+bool advise_large_pages(void* address, size_t size)
+{
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+    // Note: Transparent huge pages, the kernel falls back to regular pages whenever it can not find a free large page
+    return ::madvise(address, size, MADV_HUGEPAGE) == 0;
+#else
+    // Note: Large pages on Windows need SeLockMemoryPrivilege and can not be committed inside an existing reservation
+    (void)address;
+    (void)size;
+    return false;
+#endif
+}
+
+size_t load_file(void* address, size_t size, const char* path)
+{
+#ifndef _WIN32
+    int fd = ::open(path, O_RDONLY);
+    IF_FALSE_THROW(fd >= 0, "Failed to open " << path);
+    struct stat info;
+    bool ok = ::fstat(fd, &info) == 0;
+    size_t file_size = ok ? size_t(info.st_size) : 0;
+    ok = ok && file_size <= size && ::pread(fd, address, file_size, 0) == ssize_t(file_size);
+    ::close(fd);
+    IF_FALSE_THROW(ok, "Failed to load " << path << " (0x" << std::hex << file_size << " bytes into 0x" << size << ")");
+    return file_size;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    IF_FALSE_THROW(file.is_open(), "Failed to open " << path);
+    size_t file_size = size_t(file.tellg());
+    IF_FALSE_THROW(file_size <= size, "File does not fit: " << path);
+    file.seekg(0);
+    file.read((char*)address, file_size);
+    IF_FALSE_THROW(file.good(), "Failed to read " << path);
+    return file_size;
+#endif
+}
+
+size_t map_file(void* address, size_t size, const char* path)
+{
+#ifndef _WIN32
+    size_t host_page_size = size_t(::sysconf(_SC_PAGESIZE));
+    if ((uintptr_t(address) & (host_page_size - 1)) != 0)
+    {
+        return load_file(address, size, path);
+    }
+
+    int fd = ::open(path, O_RDONLY);
+    IF_FALSE_THROW(fd >= 0, "Failed to open " << path);
+    struct stat info;
+    bool ok = ::fstat(fd, &info) == 0;
+    size_t file_size = ok ? size_t(info.st_size) : 0;
+    ok = ok && file_size <= size;
+    if (ok && file_size > 0)
+    {
+        // Note: The tail of the last mapped page reads as zero, pages past it keep the committed memory
+        size_t mapped_size = (file_size + host_page_size - 1) & ~(host_page_size - 1);
+        ok = ::mmap(address, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == address;
+    }
+    ::close(fd);
+    IF_FALSE_THROW(ok, "Failed to map " << path << " (0x" << std::hex << file_size << " bytes into 0x" << size << ")");
+    return file_size;
+#else
+    // Note: Views can not be placed inside an existing reservation without placeholder APIs, so the file is read instead
+    return load_file(address, size, path);
+#endif
+}
+
+std::vector<uint8_t> read_file(const char* path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    IF_FALSE_THROW(file.is_open(), "Failed to open " << path);
+    std::vector<uint8_t> result(size_t(file.tellg()));
+    file.seekg(0);
+    file.read((char*)result.data(), result.size());
+    IF_FALSE_THROW(file.good() || result.empty(), "Failed to read " << path);
+    return result;
+}
+
+void release_memory(void* address, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    ::VirtualFree(address, 0, MEM_RELEASE);
+#else
+    ::munmap(address, size);
+#endif
+}
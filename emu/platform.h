@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "common.h"
+
+//
+// Platform
+// Thin wrappers around the host virtual memory API (VirtualAlloc on Windows, mmap elsewhere). Sizes and offsets must be
+// multiples of the host allocation granularity, 64 KB covers both.
+//
+
+const size_t large_page_size = 0x200000;
+
+// Reserves address space without backing it, every page is inaccessible until committed
+void* reserve_memory(size_t size);
+
+// Makes a reserved range readable and writable, committed memory is zero filled
+void commit_memory(void* address, size_t size);
+
+// Drops the contents of a committed range, the pages stay committed but read as zero and are backed again on first touch
+void discard_memory(void* address, size_t size);
+
+// Asks the host to back a committed range with large pages, as far as it is large page aligned. Returns false if the host
+// does not support it, the range then keeps its regular pages. Discarding the range drops the request.
+bool advise_large_pages(void* address, size_t size);
+
+// Reads a file to the start of a committed range and returns its size
+size_t load_file(void* address, size_t size, const char* path);
+
+// Same as load_file(), but where the host allows it (POSIX, page aligned 'address') the file is mapped copy-on-write
+// instead of read, so every range loaded from the same file shares its pages until they are written. The rest of the last
+// page reads as zero. Only for files that do not change while mapped: pages not written yet keep following the file, so a
+// later change shows up in guest memory (behind the back of the decode and block caches) and truncating it makes reads of
+// the lost pages fault. The mapped pages also replace the committed ones, so they lose any advise_large_pages() request.
+size_t map_file(void* address, size_t size, const char* path);
+
+// Reads a whole file
+std::vector<uint8_t> read_file(const char* path);
+
+// Releases a whole reservation (committed or not)
+void release_memory(void* address, size_t size);